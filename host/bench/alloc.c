@@ -0,0 +1,93 @@
+#include <errno.h>
+#include <malloc.h>
+#include <stdlib.h>
+
+#include "alloc.h"
+#include "freertos/queue.h"
+
+// glibc keeps its allocator reachable under these names, so defining malloc here takes every caller in the process
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *ptr);
+
+static uint64_t bench_allocs;
+static size_t bench_live;
+static size_t bench_peak;
+
+static void *bench_counted(void *ptr) {
+    if (ptr == NULL) {
+        return NULL;
+    }
+    host_thread_allocs++;
+    __atomic_fetch_add(&bench_allocs, 1, __ATOMIC_RELAXED);
+    size_t live = __atomic_add_fetch(&bench_live, malloc_usable_size(ptr), __ATOMIC_RELAXED);
+    size_t peak = __atomic_load_n(&bench_peak, __ATOMIC_RELAXED);
+    while (live > peak && !__atomic_compare_exchange_n(&bench_peak, &peak, live, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+    return ptr;
+}
+
+static void bench_released(void *ptr) {
+    if (ptr != NULL) {
+        __atomic_fetch_sub(&bench_live, malloc_usable_size(ptr), __ATOMIC_RELAXED);
+    }
+}
+
+void *malloc(size_t size) {
+    return bench_counted(__libc_malloc(size));
+}
+
+void *calloc(size_t count, size_t size) {
+    return bench_counted(__libc_calloc(count, size));
+}
+
+void *realloc(void *ptr, size_t size) {
+    if (ptr == NULL) {
+        return malloc(size);
+    }
+    if (size == 0) {
+        free(ptr);
+        return NULL;
+    }
+    size_t before = malloc_usable_size(ptr);
+    void *moved = __libc_realloc(ptr, size);
+    if (moved == NULL) {
+        return NULL; // ptr is still allocated
+    }
+    __atomic_fetch_sub(&bench_live, before, __ATOMIC_RELAXED);
+    return bench_counted(moved);
+}
+
+void free(void *ptr) {
+    bench_released(ptr);
+    __libc_free(ptr);
+}
+
+void *memalign(size_t alignment, size_t size) {
+    return bench_counted(__libc_memalign(alignment, size));
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size) {
+    void *aligned = memalign(alignment, size);
+    if (aligned == NULL) {
+        return ENOMEM;
+    }
+    *ptr = aligned;
+    return 0;
+}
+
+void bench_alloc_stats(bench_alloc_stats_t *stats) {
+    stats->allocs = __atomic_load_n(&bench_allocs, __ATOMIC_RELAXED);
+    stats->live = __atomic_load_n(&bench_live, __ATOMIC_RELAXED);
+    stats->peak = __atomic_load_n(&bench_peak, __ATOMIC_RELAXED);
+}
+
+void bench_alloc_reset_peak(void) {
+    __atomic_store_n(&bench_peak, __atomic_load_n(&bench_live, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+}
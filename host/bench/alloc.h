@@ -0,0 +1,14 @@
+// Counts every allocation in the process, the benchmark links it in place of the libc allocator entry points
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct bench_alloc_stats {
+    uint64_t allocs; // malloc, calloc, realloc and the aligned ones since start
+    size_t live;     // bytes currently allocated, as malloc_usable_size sees them
+    size_t peak;     // most bytes allocated at once since the last reset
+} bench_alloc_stats_t;
+
+void bench_alloc_stats(bench_alloc_stats_t *stats);
+void bench_alloc_reset_peak(void);
@@ -0,0 +1,231 @@
+// JSON string escape and unescape throughput over message text, the strings bot.c unescapes and json_string escapes
+// The word at a time scanner of jsonEscape.h is measured against checking each byte, rates are bytes of message text per second
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "jsonEscape.h"
+
+#define BENCH_PASSES 20000
+#define BENCH_WARMUP 100
+
+typedef struct bench_message {
+    char *escaped; // as the gateway sends it, without the quotes
+    size_t escaped_len;
+    char *text; // unescaped
+    size_t len;
+} bench_message_t;
+
+typedef struct bench_corpus {
+    bench_message_t *messages;
+    size_t count;
+    size_t bytes;  // of text
+    size_t longest; // escaped or not, whichever is longer
+} bench_corpus_t;
+
+typedef struct bench_case {
+    const char *name;
+    size_t (*run)(const bench_corpus_t *corpus, char *scratch); // one pass over the corpus, returns something so it is not optimized out
+} bench_case_t;
+
+static uint64_t bench_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// json_clean_run without the word loop, how escaping scanned before
+static size_t bench_clean_run_bytes(const char *value, size_t len) {
+    size_t i = 0;
+    while (i < len && !json_byte_needs_escape(value[i])) {
+        i++;
+    }
+    return i;
+}
+
+static size_t bench_escape_bytes(char *out, const char *value, size_t len) {
+    char *start = out;
+    while (len > 0) {
+        size_t run = bench_clean_run_bytes(value, len);
+        memcpy(out, value, run);
+        out += run;
+        value += run;
+        len -= run;
+        if (len > 0) {
+            size_t used;
+            out += json_escape_unit(value, len, out, &used);
+            value += used;
+            len -= used;
+        }
+    }
+    return out - start;
+}
+
+static size_t bench_run_escape(const bench_corpus_t *corpus, char *scratch) {
+    size_t total = 0;
+    for (size_t i = 0; i < corpus->count; i++) {
+        total += json_escape(scratch, corpus->messages[i].text, corpus->messages[i].len);
+    }
+    return total;
+}
+
+static size_t bench_run_escape_bytes(const bench_corpus_t *corpus, char *scratch) {
+    size_t total = 0;
+    for (size_t i = 0; i < corpus->count; i++) {
+        total += bench_escape_bytes(scratch, corpus->messages[i].text, corpus->messages[i].len);
+    }
+    return total;
+}
+
+static size_t bench_run_length(const bench_corpus_t *corpus, char *scratch) {
+    size_t total = 0;
+    for (size_t i = 0; i < corpus->count; i++) {
+        total += json_escaped_length(corpus->messages[i].text, corpus->messages[i].len);
+    }
+    return total;
+}
+
+// Unescaping works in place, so each string is copied first as bot.c copies it out of the payload
+static size_t bench_run_unescape(const bench_corpus_t *corpus, char *scratch) {
+    size_t total = 0;
+    for (size_t i = 0; i < corpus->count; i++) {
+        memcpy(scratch, corpus->messages[i].escaped, corpus->messages[i].escaped_len);
+        total += json_unescape(scratch, corpus->messages[i].escaped_len);
+    }
+    return total;
+}
+
+static const bench_case_t BENCH_CASES[] = {
+    {"escape", bench_run_escape},
+    {"escape bytewise", bench_run_escape_bytes},
+    {"escaped length", bench_run_length},
+    {"unescape", bench_run_unescape},
+};
+
+// One JSON string per line, empty lines and lines starting with # are skipped
+static bool bench_load(const char *path, bench_corpus_t *corpus) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Unable to open %s\n", path);
+        return false;
+    }
+    size_t capacity = 0;
+    char *line = NULL;
+    size_t line_size = 0;
+    ssize_t len;
+    memset(corpus, 0, sizeof(*corpus));
+    while ((len = getline(&line, &line_size, file)) >= 0) {
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+            line[--len] = '\0';
+        }
+        if (len == 0 || line[0] == '#') {
+            continue;
+        }
+        if (len < 2 || line[0] != '"' || line[len - 1] != '"') {
+            fprintf(stderr, "Skipping a line that is not a JSON string: %s\n", line);
+            continue;
+        }
+        if (corpus->count == capacity) {
+            capacity = capacity > 0 ? capacity * 2 : 32;
+            corpus->messages = realloc(corpus->messages, capacity * sizeof(bench_message_t));
+        }
+        bench_message_t *message = &corpus->messages[corpus->count++];
+        message->escaped_len = len - 2;
+        message->escaped = strndup(line + 1, message->escaped_len);
+        message->text = strndup(line + 1, message->escaped_len);
+        message->len = json_unescape(message->text, message->escaped_len);
+        corpus->bytes += message->len;
+        size_t longest = json_escaped_length(message->text, message->len);
+        if (message->escaped_len > longest) {
+            longest = message->escaped_len;
+        }
+        if (longest > corpus->longest) {
+            corpus->longest = longest;
+        }
+    }
+    free(line);
+    fclose(file);
+    return corpus->count > 0;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [-n passes] [-w warmup] [-j] [messages]\n", name);
+    fprintf(stderr, "  messages   JSON strings, one per line, default %s\n", BOT_BENCH_MESSAGES);
+    fprintf(stderr, "  -n count   passes over the messages that are measured, default %d\n", BENCH_PASSES);
+    fprintf(stderr, "  -w count   passes before measuring, default %d\n", BENCH_WARMUP);
+    fprintf(stderr, "  -j         print the results as one JSON object\n");
+}
+
+int main(int argc, char **argv) {
+    int passes = BENCH_PASSES;
+    int warmup = BENCH_WARMUP;
+    bool json = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:w:jh")) != -1) {
+        switch (opt) {
+        case 'n':
+            passes = atoi(optarg);
+            break;
+        case 'w':
+            warmup = atoi(optarg);
+            break;
+        case 'j':
+            json = true;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    const char *path = optind < argc ? argv[optind] : BOT_BENCH_MESSAGES;
+
+    bench_corpus_t corpus;
+    if (!bench_load(path, &corpus) || passes < 1) {
+        fprintf(stderr, "Nothing to measure\n");
+        return EXIT_FAILURE;
+    }
+    char *scratch = malloc(corpus.longest + 1);
+
+    // Both escapers have to agree, or the comparison means nothing
+    char *other = malloc(corpus.longest + 1);
+    for (size_t i = 0; i < corpus.count; i++) {
+        size_t len = json_escape(scratch, corpus.messages[i].text, corpus.messages[i].len);
+        if (bench_escape_bytes(other, corpus.messages[i].text, corpus.messages[i].len) != len || memcmp(scratch, other, len) != 0) {
+            fprintf(stderr, "Escapers disagree on message %zu\n", i);
+            return EXIT_FAILURE;
+        }
+    }
+    free(other);
+
+    if (json) {
+        printf("{\"messages\":%zu,\"bytes\":%zu,\"passes\":%d,\"cases\":{", corpus.count, corpus.bytes, passes);
+    } else {
+        printf("%s: %zu messages, %zu bytes of text, %d passes after %d warmup\n\n", path, corpus.count, corpus.bytes, passes, warmup);
+        printf("%-16s %10s %10s\n", "case", "MB/s", "ns/message");
+    }
+    for (int c = 0; c < sizeof(BENCH_CASES) / sizeof(BENCH_CASES[0]); c++) {
+        volatile size_t sink = 0;
+        for (int i = 0; i < warmup; i++) {
+            sink += BENCH_CASES[c].run(&corpus, scratch);
+        }
+        uint64_t start = bench_now_ns();
+        for (int i = 0; i < passes; i++) {
+            sink += BENCH_CASES[c].run(&corpus, scratch);
+        }
+        double ns = bench_now_ns() - start;
+        double mb_per_sec = (double)corpus.bytes * passes / ns * 1e3;
+        double ns_per_message = ns / ((double)corpus.count * passes);
+        if (json) {
+            printf("%s\"%s\":{\"mb_per_sec\":%.1f,\"ns_per_message\":%.1f}", c > 0 ? "," : "", BENCH_CASES[c].name, mb_per_sec, ns_per_message);
+        } else {
+            printf("%-16s %10.0f %10.1f\n", BENCH_CASES[c].name, mb_per_sec, ns_per_message);
+        }
+    }
+    if (json) {
+        printf("}}\n");
+    }
+    free(scratch);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,243 @@
+// JSON writer microbenchmark, builds the embed discord.c used to send with the old builder and with jsonBuilder.c
+// Every builder writes the same bytes, only how the buffer is managed differs
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "alloc.h"
+
+#include "jsonBuilder.c"
+#include "json_legacy.c"
+
+#define BENCH_ITERATIONS 200000
+#define BENCH_WARMUP 1000
+#define BENCH_COLOR 3447003
+
+typedef struct bench_embed {
+    const char *content;
+    const char *title;
+    const char *description;
+    const char *author;
+    const char *author_icon_url;
+    const char *footer;
+    const char *footer_icon_url;
+} bench_embed_t;
+
+// A typical announcement, only text the old builder did not have to escape
+static const bench_embed_t BENCH_EMBED = {
+    .content = "New event scheduled for this weekend",
+    .title = "Weekly game night",
+    .description = "Join us on Saturday at 8pm in the voice channel. We will start with a few rounds of the usual and move on to "
+                   "whatever gets the most votes in the poll below. Bring a friend if they want to play too.",
+    .author = "Event Bot",
+    .author_icon_url = "https://cdn.discordapp.com/avatars/100000000000000000/0123456789abcdef0123456789abcdef.png",
+    .footer = "Reply with !rsvp to join",
+    .footer_icon_url = "https://cdn.discordapp.com/emojis/200000000000000000.png",
+};
+
+typedef struct bench_builder {
+    const char *name;
+    char *(*build)(const bench_embed_t *embed, char *buffer, size_t size); // returns the json, freed unless it is buffer
+} bench_builder_t;
+
+typedef struct bench_result {
+    double ns;
+    double allocs;
+} bench_result_t;
+
+static uint64_t bench_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// discord_json_build_content before the builder appended into one buffer
+static char *bench_build_legacy(const bench_embed_t *embed, char *buffer, size_t size) {
+    legacy_json_object_t f_json = legacy_json_init();
+    legacy_json_key(&f_json, "content");
+    legacy_json_string(&f_json, embed->content);
+    legacy_json_key(&f_json, "embed");
+    legacy_json_open_list(&f_json);
+    legacy_json_key(&f_json, "title");
+    legacy_json_string(&f_json, embed->title);
+    legacy_json_key(&f_json, "description");
+    legacy_json_string(&f_json, embed->description);
+    legacy_json_key(&f_json, "author");
+    legacy_json_open_list(&f_json);
+    legacy_json_key(&f_json, "name");
+    legacy_json_string(&f_json, embed->author);
+    legacy_json_key(&f_json, "icon_url");
+    legacy_json_string(&f_json, embed->author_icon_url);
+    legacy_json_close_list(&f_json);
+    legacy_json_key(&f_json, "footer");
+    legacy_json_open_list(&f_json);
+    legacy_json_key(&f_json, "text");
+    legacy_json_string(&f_json, embed->footer);
+    legacy_json_key(&f_json, "icon_url");
+    legacy_json_string(&f_json, embed->footer_icon_url);
+    legacy_json_close_list(&f_json);
+    legacy_json_key(&f_json, "color");
+    char str[12];
+    sprintf(str, "%d", BENCH_COLOR);
+    legacy_json_value(&f_json, str);
+    legacy_json_close_list(&f_json);
+    return legacy_json_finish(&f_json);
+}
+
+static char *bench_write(json_object_t *f_json, const bench_embed_t *embed) {
+    json_key(f_json, "content");
+    json_string(f_json, embed->content);
+    json_key(f_json, "embed");
+    json_open_list(f_json);
+    json_key(f_json, "title");
+    json_string(f_json, embed->title);
+    json_key(f_json, "description");
+    json_string(f_json, embed->description);
+    json_key(f_json, "author");
+    json_open_list(f_json);
+    json_key(f_json, "name");
+    json_string(f_json, embed->author);
+    json_key(f_json, "icon_url");
+    json_string(f_json, embed->author_icon_url);
+    json_close_list(f_json);
+    json_key(f_json, "footer");
+    json_open_list(f_json);
+    json_key(f_json, "text");
+    json_string(f_json, embed->footer);
+    json_key(f_json, "icon_url");
+    json_string(f_json, embed->footer_icon_url);
+    json_close_list(f_json);
+    json_key(f_json, "color");
+    json_int(f_json, BENCH_COLOR);
+    json_close_list(f_json);
+    return json_finish(f_json).ptr;
+}
+
+// Starts small and doubles, what a caller without an estimate gets
+static char *bench_build_growable(const bench_embed_t *embed, char *buffer, size_t size) {
+    json_object_t f_json = json_init();
+    return bench_write(&f_json, embed);
+}
+
+// Sized from the field lengths as discord.c did, one allocation
+static char *bench_build_presized(const bench_embed_t *embed, char *buffer, size_t size) {
+    const char *fields[] = {embed->content, embed->title, embed->description, embed->author, embed->author_icon_url, embed->footer, embed->footer_icon_url};
+    size_t capacity = 160; // keys, punctuation and the color
+    for (int i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        capacity += strlen(fields[i]);
+    }
+    json_object_t f_json = json_init_capacity(capacity);
+    return bench_write(&f_json, embed);
+}
+
+// Into the caller's buffer, nothing is allocated
+static char *bench_build_buffer(const bench_embed_t *embed, char *buffer, size_t size) {
+    json_object_t f_json = json_init_buffer(buffer, size);
+    return bench_write(&f_json, embed);
+}
+
+static const bench_builder_t BENCH_BUILDERS[] = {
+    {"legacy", bench_build_legacy},
+    {"growable", bench_build_growable},
+    {"presized", bench_build_presized},
+    {"buffer", bench_build_buffer},
+};
+
+static bench_result_t bench_run(const bench_builder_t *builder, int iterations, int warmup) {
+    char buffer[1024];
+    for (int i = 0; i < warmup; i++) {
+        char *json = builder->build(&BENCH_EMBED, buffer, sizeof(buffer));
+        if (json != buffer) {
+            free(json);
+        }
+    }
+    bench_alloc_stats_t before, after;
+    bench_alloc_stats(&before);
+    uint64_t start = bench_now_ns();
+    for (int i = 0; i < iterations; i++) {
+        char *json = builder->build(&BENCH_EMBED, buffer, sizeof(buffer));
+        if (json != buffer) {
+            free(json);
+        }
+    }
+    uint64_t ns = bench_now_ns() - start;
+    bench_alloc_stats(&after);
+    bench_result_t result = {
+        .ns = (double)ns / iterations,
+        .allocs = (double)(after.allocs - before.allocs) / iterations,
+    };
+    return result;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [-n iterations] [-w warmup] [-j]\n", name);
+    fprintf(stderr, "  -n count   embeds built by each builder, default %d\n", BENCH_ITERATIONS);
+    fprintf(stderr, "  -w count   embeds built before measuring, default %d\n", BENCH_WARMUP);
+    fprintf(stderr, "  -j         print the results as one JSON object\n");
+}
+
+int main(int argc, char **argv) {
+    int iterations = BENCH_ITERATIONS;
+    int warmup = BENCH_WARMUP;
+    bool json = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:w:jh")) != -1) {
+        switch (opt) {
+        case 'n':
+            iterations = atoi(optarg);
+            break;
+        case 'w':
+            warmup = atoi(optarg);
+            break;
+        case 'j':
+            json = true;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (iterations < 1) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // Every builder has to produce what the old one did, or the comparison means nothing
+    char expected[1024], buffer[1024];
+    char *legacy = bench_build_legacy(&BENCH_EMBED, NULL, 0);
+    snprintf(expected, sizeof(expected), "%s", legacy);
+    free(legacy);
+    for (int i = 1; i < sizeof(BENCH_BUILDERS) / sizeof(BENCH_BUILDERS[0]); i++) {
+        char *built = BENCH_BUILDERS[i].build(&BENCH_EMBED, buffer, sizeof(buffer));
+        bool same = built != NULL && strcmp(built, expected) == 0;
+        if (built != buffer) {
+            free(built);
+        }
+        if (!same) {
+            fprintf(stderr, "%s builds different JSON than legacy\n", BENCH_BUILDERS[i].name);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (json) {
+        printf("{\"bytes\":%zu,\"iterations\":%d,\"builders\":{", strlen(expected), iterations);
+    } else {
+        printf("%zu byte embed, %d builds each after %d warmup\n\n", strlen(expected), iterations, warmup);
+        printf("%-10s %10s %12s\n", "builder", "ns/build", "allocs/embed");
+    }
+    for (int i = 0; i < sizeof(BENCH_BUILDERS) / sizeof(BENCH_BUILDERS[0]); i++) {
+        bench_result_t result = bench_run(&BENCH_BUILDERS[i], iterations, warmup);
+        if (json) {
+            printf("%s\"%s\":{\"ns_per_build\":%.1f,\"allocs_per_embed\":%.2f}", i > 0 ? "," : "", BENCH_BUILDERS[i].name, result.ns,
+                   result.allocs);
+        } else {
+            printf("%-10s %10.0f %12.2f\n", BENCH_BUILDERS[i].name, result.ns, result.allocs);
+        }
+    }
+    if (json) {
+        printf("}}\n");
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,105 @@
+// The JSON builder as it was before it appended into one buffer, kept so json_bench can compare against it
+// Every call reallocates the whole string, its names carry a legacy_ prefix so it links next to jsonBuilder.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char LEGACY_JSON_Key[] = "\"%s\":";
+static const char LEGACY_JSON_String[] = "\"%s\"";
+static const char *LEGACY_JSON_Array_Open = "[";
+static const char *LEGACY_JSON_Array_Close = "]";
+static const char *LEGACY_JSON_List_Open = "{";
+static const char *LEGACY_JSON_List_Close = "}";
+static const char *LEGACY_JSON_Comma = ",";
+
+// Append string by redefining string pointer
+static inline void legacy_str_append(char **string, const char *append) {
+    char *new_str = calloc(1, strlen(*string) + strlen(append) + 1);
+    strcat(new_str, *string);
+    strcat(new_str, append);
+    free(*string);
+    *string = new_str;
+}
+
+// Single parameter string format by redefining string pointer
+static inline void legacy_pfstr(char **string, const char *pattern, const char *value) {
+    int len = strlen(pattern) + strlen(value) + 1;
+    char *new_str = calloc(1, len);
+    snprintf(new_str, len, pattern, value);
+    free(*string);
+    *string = new_str;
+}
+
+// Append a single parameter formatted string by redefining string pointer
+static inline void legacy_pfstr_append(char **string, const char *pattern, const char *value) {
+    char *pf_str = malloc(0);
+    legacy_pfstr(&pf_str, pattern, value);
+    legacy_str_append(string, pf_str);
+    free(pf_str);
+}
+
+typedef struct legacy_json_object {
+    char *string;
+    // bool expecting_key; // IMPROVE: error checking json building
+    // bool expecting_value;
+    // bool finished;
+    unsigned int addComma; // massive jsons would have issues but idc
+} legacy_json_object_t;
+
+static legacy_json_object_t legacy_json_init() {
+    legacy_json_object_t obj = {
+        .string = strdup(LEGACY_JSON_List_Open), // Start Json
+        // .expecting_key = true,
+        // .expecting_value = false,
+        // .finished = false,
+        .addComma = 0,
+    };
+    return obj;
+}
+
+static char *legacy_json_finish(legacy_json_object_t *json) {
+    legacy_str_append(&json->string, LEGACY_JSON_List_Close);
+    // json->finished = false;
+    return json->string;
+}
+
+static void legacy_json_open_array(legacy_json_object_t *json) {
+    json->addComma <<= 1;
+    legacy_str_append(&json->string, LEGACY_JSON_Array_Open);
+}
+
+static void legacy_json_close_array(legacy_json_object_t *json) {
+    json->addComma >>= 1;
+    legacy_str_append(&json->string, LEGACY_JSON_Array_Close);
+}
+
+static void legacy_json_open_list(legacy_json_object_t *json) {
+    json->addComma <<= 1;
+    legacy_str_append(&json->string, LEGACY_JSON_List_Open);
+}
+
+static void legacy_json_close_list(legacy_json_object_t *json) {
+    json->addComma >>= 1;
+    legacy_str_append(&json->string, LEGACY_JSON_List_Close);
+}
+
+static void legacy_json_value(legacy_json_object_t *json, const char *key) {
+    legacy_str_append(&json->string, key);
+}
+
+static void legacy_json_string(legacy_json_object_t *json, const char *key) {
+    int len = strlen(LEGACY_JSON_String) + strlen(key) + 1;
+    char *str = calloc(1, len);
+    snprintf(str, len, LEGACY_JSON_String, key);
+    legacy_json_value(json, str);
+    free(str);
+}
+
+static void legacy_json_key(legacy_json_object_t *json, const char *key) {
+    if (json->addComma & 1) {
+        legacy_str_append(&json->string, LEGACY_JSON_Comma);
+    } else {
+        json->addComma |= 1;
+    }
+    legacy_pfstr_append(&json->string, LEGACY_JSON_Key, key);
+}
\ No newline at end of file
@@ -0,0 +1,223 @@
+// Gateway replay benchmark, the same startup as main_host.c without a websocket client
+// Every frame of the corpus goes through websocket_event_handler -> BOT_payload_task -> BOT_command_queue as fast as the queues drain
+// Stage times are measured where the device spends them: the handler call, and the time each task serves an item it took from its queue
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+#include "esp_log.h"
+#include "esp_system.h"
+
+#include "alloc.h"
+#include "mem_place.h"
+#include "tls_shared.h"
+
+#include "bot.c"
+#include "websocket.c"
+
+#define BENCH_ITERATIONS 1000
+#define BENCH_WARMUP 10
+
+static const char LOG_TAG[] = "Bench";
+
+typedef struct bench_frame {
+    char *data;
+    int len;
+} bench_frame_t;
+
+typedef struct bench_stage {
+    const char *name;
+    uint64_t items;
+    uint64_t ns;
+    uint64_t allocs;
+} bench_stage_t;
+
+static void websocket_data_handler(char *data) {
+    websocket_send_text(data); // nothing is connected, so login and heartbeats go nowhere
+}
+
+static uint64_t bench_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// One frame per line, empty lines and lines starting with # are skipped
+static bench_frame_t *bench_load(const char *path, size_t *count, size_t *bytes) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        ESP_LOGE(LOG_TAG, "Unable to open %s", path);
+        return NULL;
+    }
+    bench_frame_t *frames = NULL;
+    size_t capacity = 0;
+    char *line = NULL;
+    size_t line_size = 0;
+    ssize_t len;
+    *count = 0;
+    *bytes = 0;
+    while ((len = getline(&line, &line_size, file)) >= 0) {
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+            line[--len] = '\0';
+        }
+        if (len == 0 || line[0] == '#') {
+            continue;
+        }
+        if (len > WEBSOCKET_BUFFER_SIZE) {
+            ESP_LOGW(LOG_TAG, "Frame of %d bytes does not fit the %d byte buffer, skipping it", (int)len, WEBSOCKET_BUFFER_SIZE);
+            continue;
+        }
+        if (*count == capacity) {
+            capacity = capacity > 0 ? capacity * 2 : 32;
+            frames = realloc(frames, capacity * sizeof(bench_frame_t));
+        }
+        frames[*count].data = strndup(line, len);
+        frames[*count].len = len;
+        (*count)++;
+        *bytes += len;
+    }
+    free(line);
+    fclose(file);
+    return frames;
+}
+
+// Feeds the corpus as fast as the gateway queue takes it and returns once every command it queued was picked up
+static void bench_run(const bench_frame_t *frames, size_t count, int iterations, bench_stage_t *ingest) {
+    esp_websocket_event_data_t event = {.op_code = 1};
+    for (int i = 0; i < iterations; i++) {
+        for (size_t f = 0; f < count; f++) {
+            host_queue_wait_space(message_queue); // the handler drops frames on a full queue, the device would leave them in the socket
+            event.data_ptr = frames[f].data;
+            event.data_len = frames[f].len;
+            event.payload_len = frames[f].len;
+            uint64_t start = bench_now_ns();
+            uint64_t allocs = host_thread_allocs;
+            websocket_event_handler(NULL, WEBSOCKET_EVENTS, WEBSOCKET_EVENT_DATA, &event);
+            ingest->ns += bench_now_ns() - start;
+            ingest->allocs += host_thread_allocs - allocs;
+            ingest->items++;
+        }
+    }
+    host_queue_wait_idle(message_queue);
+    host_queue_wait_idle(BOT_command_queue);
+}
+
+static void bench_stage_from_queue(bench_stage_t *stage, QueueHandle_t queue) {
+    host_queue_stats_t stats;
+    host_queue_stats(queue, &stats, false);
+    stage->items = stats.received;
+    stage->ns = stats.service_ns;
+    stage->allocs = stats.service_allocs;
+}
+
+static double bench_per_item(uint64_t total, uint64_t items) {
+    return items > 0 ? (double)total / items : 0;
+}
+
+static void bench_print(const bench_stage_t *stages, int count, uint64_t events, uint64_t wall_ns, const bench_alloc_stats_t *before,
+                        const bench_alloc_stats_t *after, bool json) {
+    double seconds = wall_ns / 1e9;
+    uint64_t allocs = after->allocs - before->allocs;
+    if (json) {
+        printf("{\"events\":%llu,\"seconds\":%.6f,\"events_per_sec\":%.1f,\"stages\":{", (unsigned long long)events, seconds, events / seconds);
+        for (int i = 0; i < count; i++) {
+            printf("%s\"%s\":{\"items\":%llu,\"ns_per_item\":%.1f,\"allocs_per_item\":%.3f}", i > 0 ? "," : "", stages[i].name,
+                   (unsigned long long)stages[i].items, bench_per_item(stages[i].ns, stages[i].items), bench_per_item(stages[i].allocs, stages[i].items));
+        }
+        printf("},\"allocs_per_event\":%.3f,\"peak_heap\":%zu,\"peak_heap_growth\":%zu}\n", bench_per_item(allocs, events), after->peak,
+               after->peak - before->live);
+        return;
+    }
+    printf("%llu events in %.1f ms, %.0f events/s\n\n", (unsigned long long)events, seconds * 1e3, events / seconds);
+    printf("%-14s %10s %12s %12s\n", "stage", "items", "ns/item", "allocs/item");
+    for (int i = 0; i < count; i++) {
+        printf("%-14s %10llu %12.0f %12.2f\n", stages[i].name, (unsigned long long)stages[i].items, bench_per_item(stages[i].ns, stages[i].items),
+               bench_per_item(stages[i].allocs, stages[i].items));
+    }
+    printf("\n%llu allocations, %.2f per event\n", (unsigned long long)allocs, bench_per_item(allocs, events));
+    printf("Peak heap %zu bytes, %zu above the start of the run\n", after->peak, after->peak - before->live);
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [-n iterations] [-w warmup] [-j] [-v] [corpus]\n", name);
+    fprintf(stderr, "  corpus     gateway frames, one per line, default %s\n", BOT_BENCH_CORPUS);
+    fprintf(stderr, "  -n count   passes over the corpus that are measured, default %d\n", BENCH_ITERATIONS);
+    fprintf(stderr, "  -w count   passes before measuring, default %d\n", BENCH_WARMUP);
+    fprintf(stderr, "  -j         print the results as one JSON object\n");
+    fprintf(stderr, "  -v         log what the bot does, slows it down a lot\n");
+}
+
+int main(int argc, char **argv) {
+    int iterations = BENCH_ITERATIONS;
+    int warmup = BENCH_WARMUP;
+    bool json = false;
+    int opt;
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    while ((opt = getopt(argc, argv, "n:w:jvh")) != -1) {
+        switch (opt) {
+        case 'n':
+            iterations = atoi(optarg);
+            break;
+        case 'w':
+            warmup = atoi(optarg);
+            break;
+        case 'j':
+            json = true;
+            break;
+        case 'v':
+            esp_log_level_set("*", ESP_LOG_INFO);
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    const char *path = optind < argc ? argv[optind] : BOT_BENCH_CORPUS;
+
+    size_t count, bytes;
+    bench_frame_t *frames = bench_load(path, &count, &bytes);
+    if (frames == NULL || count == 0 || iterations < 1) {
+        ESP_LOGE(LOG_TAG, "Nothing to replay");
+        return EXIT_FAILURE;
+    }
+
+    ESP_ERROR_CHECK(tls_shared_init());
+    QueueHandle_t gateway_queue = websocket_init();
+    if (gateway_queue == NULL) {
+        ESP_LOGE(LOG_TAG, "Websocket failed to initialize, aborting");
+        abort();
+    }
+    ESP_ERROR_CHECK(BOT_init(websocket_data_handler, gateway_queue));
+
+    bench_stage_t stages[] = {{.name = "ingest"}, {.name = "parse"}, {.name = "command queue"}};
+    bench_run(frames, count, warmup, &stages[0]);
+
+    // Only the measured passes count from here on
+    host_queue_stats_t discard;
+    host_queue_stats(gateway_queue, &discard, true);
+    host_queue_stats(BOT_command_queue, &discard, true);
+    memset(&stages[0], 0, sizeof(stages[0]));
+    stages[0].name = "ingest";
+    bench_alloc_stats_t before, after;
+    bench_alloc_reset_peak();
+    bench_alloc_stats(&before);
+
+    uint64_t start = bench_now_ns();
+    bench_run(frames, count, iterations, &stages[0]);
+    uint64_t wall_ns = bench_now_ns() - start;
+    bench_alloc_stats(&after);
+    bench_stage_from_queue(&stages[1], gateway_queue);
+    bench_stage_from_queue(&stages[2], BOT_command_queue);
+
+    if (!json) {
+        printf("%s: %zu frames, %zu bytes, %d passes after %d warmup\n", path, count, bytes, iterations, warmup);
+    }
+    bench_print(stages, sizeof(stages) / sizeof(stages[0]), stages[0].items, wall_ns, &before, &after, json);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,12 @@
+// The host defaults, with what would drop commands at full rate turned off so every command reaches the queue
+#pragma once
+
+#include_next "sdkconfig.h"
+
+#undef CONFIG_BOT_LIMIT_USER_INTERVAL_MS
+#undef CONFIG_BOT_LIMIT_CHANNEL_INTERVAL_MS
+#undef CONFIG_BOT_LIMIT_NOTICE
+#define CONFIG_BOT_LIMIT_USER_INTERVAL_MS 0 // a key may always send again
+#define CONFIG_BOT_LIMIT_CHANNEL_INTERVAL_MS 0
+
+#undef CONFIG_TRACE_ENABLE // measure what the device runs by default
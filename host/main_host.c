@@ -0,0 +1,89 @@
+// app_main for Linux, the same startup as main.c without WiFi and the LED
+// Gateway frames are replayed from a file, what the bot sends to the gateway and REST goes to stdout
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+#include "esp_log.h"
+#include "esp_system.h"
+
+#include "mem_place.h"
+#include "tls_shared.h"
+#include "trace.h"
+
+#include "bot.c"
+#include "websocket.c"
+
+#define HOST_LINGER_MS 1000 // replies that are still on their way after the last frame
+
+static const char LOG_TAG[] = "Main";
+
+static void websocket_data_handler(char *data) {
+    websocket_send_text(data);
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [-q] [-v] [-t] [-l linger_ms] [frames]\n", name);
+    fprintf(stderr, "  frames     gateway frames, one per line, - or nothing for stdin\n");
+    fprintf(stderr, "  -q         only log warnings and errors\n");
+    fprintf(stderr, "  -v         log debug output\n");
+    fprintf(stderr, "  -t         print the latency trace when done, for host/trace.py\n");
+    fprintf(stderr, "  -l ms      how long to keep running after the last frame, default %d\n", HOST_LINGER_MS);
+}
+
+int main(int argc, char **argv) {
+    int linger_ms = HOST_LINGER_MS;
+    bool trace = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "qvtl:h")) != -1) {
+        switch (opt) {
+        case 'q':
+            esp_log_level_set("*", ESP_LOG_WARN);
+            break;
+        case 'v':
+            esp_log_level_set("*", ESP_LOG_DEBUG);
+            break;
+        case 't':
+            trace = true;
+            break;
+        case 'l':
+            linger_ms = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    const char *frames = optind < argc ? argv[optind] : "-";
+
+    ESP_LOGI(LOG_TAG, "Startup..");
+    ESP_LOGI(LOG_TAG, "IDF version: %s", esp_get_idf_version());
+
+    ESP_ERROR_CHECK(tls_shared_init());
+
+    QueueHandle_t message_queue = websocket_init();
+    if (message_queue == NULL) {
+        ESP_LOGE(LOG_TAG, "Websocket failed to initialize, aborting");
+        abort();
+    }
+    host_gateway_replay(frames, message_queue);
+
+    ESP_ERROR_CHECK(BOT_init(websocket_data_handler, message_queue));
+    ESP_ERROR_CHECK(websocket_app_start());
+
+    uint32_t replayed = host_gateway_wait();
+    while (uxQueueMessagesWaiting(message_queue) > 0) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    vTaskDelay(pdMS_TO_TICKS(linger_ms));
+    ESP_LOGI(LOG_TAG, "Replayed %u frames", replayed);
+    mem_place_log();
+    if (trace) {
+        trace_dump();
+    }
+    return EXIT_SUCCESS;
+}
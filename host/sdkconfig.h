@@ -0,0 +1,53 @@
+// Kconfig.projbuild defaults for the host build, edit here instead of menuconfig
+#pragma once
+
+#define CONFIG_IDF_TARGET_LINUX 1
+#define CONFIG_LOG_DEFAULT_LEVEL 3
+
+#define CONFIG_BOT_TOKEN "host"
+#define CONFIG_BOT_PREFIX "!Cast"
+#define CONFIG_BOT_COLOR 0xba51f7
+#define CONFIG_BOT_HELP 1
+#define CONFIG_BOT_BASIC_HELP 1
+#define CONFIG_BOT_CASTER_ROLE "Caster"
+#define CONFIG_BOT_JSMN_TOKENS 1024
+#define CONFIG_BOT_ASYNC_MAX_PENDING 16
+#define CONFIG_BOT_THINKING_TEXT "Thinking..."
+#define CONFIG_BOT_CACHE_GUILDS 4
+#define CONFIG_BOT_CACHE_CHANNELS 128
+#define CONFIG_BOT_CACHE_ROLES 128
+#define CONFIG_BOT_INTERN_POOL 6144
+#define CONFIG_BOT_INTERN_STRINGS 512
+#define CONFIG_BOT_LIMIT_USER_INTERVAL_MS 2000
+#define CONFIG_BOT_LIMIT_USER_BURST 3
+#define CONFIG_BOT_LIMIT_CHANNEL_INTERVAL_MS 500
+#define CONFIG_BOT_LIMIT_CHANNEL_BURST 10
+#define CONFIG_BOT_LIMIT_SLOTS 64
+#define CONFIG_BOT_LIMIT_NOTICE 1
+
+#define CONFIG_HTTP_HOST "discordapp.com"
+#define CONFIG_HTTP_MAX_BUFFER 2048
+#define CONFIG_HTTP_STREAM_BUFFER 256
+#define CONFIG_HTTP_PATH_CACHE_SIZE 8
+#define CONFIG_HTTP_QUEUE_SIZE 8
+#define CONFIG_HTTP_QUEUE_TIMEOUT_MS 0
+#define CONFIG_HTTP_QUEUE_DROP_OLDEST 1
+
+#define CONFIG_REST_PATH_PATTERN "/api/channels/%s/messages"
+#define CONFIG_REST_MESSAGE_PATH_PATTERN "/api/channels/%s/messages/%s"
+#define CONFIG_REST_WEBHOOK_PATH_PATTERN "/api/webhooks/%s/%s"
+#define CONFIG_REST_MAX_WEBHOOKS 2
+#define CONFIG_REST_ANNOUNCE_CHANNEL_ID ""
+#define CONFIG_REST_ANNOUNCE_WEBHOOK_URL ""
+#define CONFIG_REST_MESSAGE_ARENA_SIZE 2048
+#define CONFIG_REST_AUTH_PREFIX "Bot "
+
+#define CONFIG_TLS_SERIALIZE_HANDSHAKES 1 // there is no certificate bundle, so servers are not verified
+
+#define CONFIG_WEBSOCKET_BUFFER_SIZE 8192
+#define CONFIG_WEBSOCKET_QUEUE_SIZE 3
+#define CONFIG_WEBSOCKET_URI "wss://gateway.discord.gg/?v=6&encoding=json"
+#define CONFIG_WEBSOCKET_TIMEOUT_SEC 10
+
+#define CONFIG_TRACE_ENABLE 1 // off on the device by default, bot_host -t dumps the records when it is done
+#define CONFIG_TRACE_RECORDS 512
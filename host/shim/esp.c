@@ -0,0 +1,136 @@
+#include <malloc.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+
+#define HOST_SHUTDOWN_HANDLERS 4
+
+esp_log_level_t host_log_level = CONFIG_LOG_DEFAULT_LEVEL;
+
+static shutdown_handler_t host_shutdown_handlers[HOST_SHUTDOWN_HANDLERS];
+
+static int64_t host_now_us(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static int64_t host_start_us;
+
+__attribute__((constructor)) static void host_start(void) {
+    host_start_us = host_now_us();
+}
+
+int64_t esp_timer_get_time(void) {
+    return host_now_us() - host_start_us;
+}
+
+uint32_t esp_log_timestamp(void) {
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level) {
+    host_log_level = level;
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+}
+
+const char *esp_err_to_name(esp_err_t code) {
+    switch (code) {
+    case ESP_OK:
+        return "ESP_OK";
+    case ESP_FAIL:
+        return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:
+        return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:
+        return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:
+        return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:
+        return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND:
+        return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_TIMEOUT:
+        return "ESP_ERR_TIMEOUT";
+    default:
+        return "UNKNOWN ERROR";
+    }
+}
+
+void esp_restart(void) {
+    fprintf(stderr, "esp_restart called, exiting\n");
+    for (int i = HOST_SHUTDOWN_HANDLERS - 1; i >= 0; i--) {
+        if (host_shutdown_handlers[i] != NULL) {
+            host_shutdown_handlers[i]();
+        }
+    }
+    exit(EXIT_FAILURE);
+}
+
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handler) {
+    for (int i = 0; i < HOST_SHUTDOWN_HANDLERS; i++) {
+        if (host_shutdown_handlers[i] == NULL) {
+            host_shutdown_handlers[i] = handler;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+uint32_t esp_get_free_heap_size(void) {
+    return 0; // the process heap grows on demand, there is nothing meaningful to report
+}
+
+const char *esp_get_idf_version(void) {
+    return "host";
+}
+
+void *heap_caps_malloc(size_t size, uint32_t caps) {
+    return malloc(size);
+}
+
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps) {
+    return calloc(n, size);
+}
+
+void heap_caps_free(void *ptr) {
+    free(ptr);
+}
+
+// Only internal RAM exists here, it reports what the process heap is using
+size_t heap_caps_get_free_size(uint32_t caps) {
+    if (caps & MALLOC_CAP_SPIRAM) {
+        return 0;
+    }
+    struct mallinfo2 info = mallinfo2();
+    return info.fordblks;
+}
+
+size_t heap_caps_get_total_size(uint32_t caps) {
+    if (caps & MALLOC_CAP_SPIRAM) {
+        return 0;
+    }
+    struct mallinfo2 info = mallinfo2();
+    return info.arena + info.hblkhd;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps) {
+    return heap_caps_get_free_size(caps);
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps) {
+    return heap_caps_get_free_size(caps);
+}
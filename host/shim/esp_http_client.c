@@ -0,0 +1,186 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#include "esp_http_client.h"
+
+#define HOST_HTTP_MAX_URL 256
+
+struct esp_http_client {
+    esp_http_client_config_t config;
+    esp_http_client_method_t method;
+    char url[HOST_HTTP_MAX_URL];
+    const char *post_data;
+    int post_len;
+    int written; // body bytes written after open
+    int status;
+    bool connected;
+    bool authorized; // an Authorization header is set, requests without one are logged as such
+    bool logged;
+    uint32_t latency_ms;
+};
+
+static uint64_t host_http_next_id = 900000000000000000ULL; // ids of messages that were created
+
+static void host_http_event(esp_http_client_handle_t client, esp_http_client_event_id_t id, void *data, int len, char *key, char *value) {
+    if (client->config.event_handler == NULL) {
+        return;
+    }
+    esp_http_client_event_t event = {
+        .event_id = id,
+        .client = client,
+        .data = data,
+        .data_len = len,
+        .user_data = client->config.user_data,
+        .header_key = key,
+        .header_value = value,
+    };
+    client->config.event_handler(&event);
+}
+
+static const char *host_http_method(esp_http_client_method_t method) {
+    static const char *const names[] = {"GET", "POST", "PUT", "PATCH", "DELETE"};
+    return method <= HTTP_METHOD_DELETE ? names[method] : "?";
+}
+
+// The channel is the path segment after /channels/, "0" if there is none
+static void host_http_channel(const char *url, char *out, size_t size) {
+    const char *start = strstr(url, "/channels/");
+    size_t len = 0;
+    if (start != NULL) {
+        start += strlen("/channels/");
+        len = strcspn(start, "/?");
+    }
+    if (len == 0 || len >= size) {
+        snprintf(out, size, "0");
+    } else {
+        memcpy(out, start, len);
+        out[len] = '\0';
+    }
+}
+
+// Answer as discord would once the whole body is there, created messages get a fresh id
+static void host_http_respond(esp_http_client_handle_t client) {
+    if (!client->connected) {
+        client->connected = true;
+        host_http_event(client, HTTP_EVENT_ON_CONNECTED, NULL, 0, NULL, NULL);
+    }
+    if (client->logged) {
+        printf("HTTP %s %s%s %.*s\n", host_http_method(client->method), client->url, client->authorized ? "" : " (no auth)", client->post_len,
+               client->post_data != NULL ? client->post_data : "");
+        fflush(stdout);
+    }
+    if (client->latency_ms > 0) {
+        usleep(client->latency_ms * 1000);
+    }
+    host_http_event(client, HTTP_EVENT_ON_HEADER, NULL, 0, "X-RateLimit-Remaining", "5");
+    host_http_event(client, HTTP_EVENT_ON_HEADER, NULL, 0, "X-RateLimit-Reset-After", "1.0");
+    if (client->method == HTTP_METHOD_DELETE) {
+        client->status = 204;
+        return;
+    }
+    char channel[24];
+    char body[128];
+    host_http_channel(client->url, channel, sizeof(channel));
+    int len = snprintf(body, sizeof(body), "{\"id\":\"%" PRIu64 "\",\"type\":0,\"channel_id\":\"%s\"}", __atomic_fetch_add(&host_http_next_id, 1, __ATOMIC_RELAXED),
+                       channel);
+    client->status = 200;
+    host_http_event(client, HTTP_EVENT_ON_DATA, body, len, NULL, NULL);
+}
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config) {
+    esp_http_client_handle_t client = calloc(1, sizeof(struct esp_http_client));
+    if (client == NULL) {
+        return NULL;
+    }
+    client->config = *config;
+    client->method = HTTP_METHOD_GET;
+    const char *latency = getenv("HOST_HTTP_LATENCY_MS");
+    client->latency_ms = latency != NULL ? strtoul(latency, NULL, 10) : 0;
+    client->logged = getenv("HOST_HTTP_LOG") != NULL;
+    return client;
+}
+
+esp_err_t esp_http_client_set_url(esp_http_client_handle_t client, const char *url) {
+    snprintf(client->url, sizeof(client->url), "%s", url);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_method(esp_http_client_handle_t client, esp_http_client_method_t method) {
+    client->method = method;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value) {
+    if (strcasecmp(key, "Authorization") == 0) {
+        client->authorized = true;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_delete_header(esp_http_client_handle_t client, const char *key) {
+    if (strcasecmp(key, "Authorization") == 0) {
+        client->authorized = false;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_post_field(esp_http_client_handle_t client, const char *data, int len) {
+    client->post_data = data;
+    client->post_len = len;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_perform(esp_http_client_handle_t client) {
+    host_http_respond(client);
+    return ESP_OK;
+}
+
+// Streamed bodies are counted but not kept, they are only logged as their length
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len) {
+    client->post_data = NULL;
+    client->post_len = 0;
+    client->written = 0;
+    return ESP_OK;
+}
+
+int esp_http_client_write(esp_http_client_handle_t client, const char *buffer, int len) {
+    client->written += len;
+    return len;
+}
+
+int esp_http_client_fetch_headers(esp_http_client_handle_t client) {
+    char streamed[32];
+    int len = snprintf(streamed, sizeof(streamed), "<%d bytes streamed>", client->written);
+    client->post_data = streamed;
+    client->post_len = len;
+    host_http_respond(client);
+    client->post_data = NULL;
+    client->post_len = 0;
+    return 0;
+}
+
+int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len) {
+    return 0; // the response was already handed to the event handler
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client) {
+    return client->status;
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t client) {
+    if (client->connected) {
+        client->connected = false;
+        host_http_event(client, HTTP_EVENT_DISCONNECTED, NULL, 0, NULL, NULL);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client) {
+    esp_http_client_close(client);
+    free(client);
+    return ESP_OK;
+}
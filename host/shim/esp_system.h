@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+typedef void (*shutdown_handler_t)(void);
+
+void esp_restart(void) __attribute__((noreturn)); // exits, there is nothing to reconnect to
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handler);
+uint32_t esp_get_free_heap_size(void);
+const char *esp_get_idf_version(void);
@@ -0,0 +1,5 @@
+#pragma once
+
+#include "esp_err.h"
+
+typedef struct esp_transport_item *esp_transport_handle_t;
@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_websocket_client.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+ESP_EVENT_DEFINE_BASE(WEBSOCKET_EVENTS);
+
+static const char *TAG = "WEBSOCKET_CLIENT";
+
+struct esp_websocket_client {
+    esp_websocket_client_config_t config;
+    esp_event_handler_t handler;
+    void *handler_args;
+    char *line; // one frame, grown to the longest line
+    size_t line_size;
+    bool connected;
+};
+
+static const char *host_gateway_path;
+static QueueHandle_t host_gateway_queue;
+static SemaphoreHandle_t host_gateway_done;
+static uint32_t host_gateway_frames;
+
+void host_gateway_replay(const char *path, QueueHandle_t queue) {
+    host_gateway_path = path;
+    host_gateway_queue = queue;
+    host_gateway_done = xSemaphoreCreateBinary();
+}
+
+uint32_t host_gateway_wait(void) {
+    xSemaphoreTake(host_gateway_done, portMAX_DELAY);
+    xSemaphoreGive(host_gateway_done); // later waits return at once
+    return host_gateway_frames;
+}
+
+// Payloads longer than the buffer are posted in pieces, as the real client reads them
+static void host_gateway_event(esp_websocket_client_handle_t client, esp_websocket_event_id_t id, const char *data, int len) {
+    int offset = 0;
+    do {
+        int piece = len - offset < client->config.buffer_size ? len - offset : client->config.buffer_size;
+        esp_websocket_event_data_t event = {
+            .data_ptr = data != NULL ? data + offset : NULL,
+            .data_len = piece,
+            .op_code = 1, // text
+            .client = client,
+            .user_context = client->config.user_context,
+            .payload_len = len,
+            .payload_offset = offset,
+        };
+        client->handler(client->handler_args, WEBSOCKET_EVENTS, id, &event);
+        offset += piece;
+    } while (offset < len);
+}
+
+static void host_gateway_task(void *pvParameters) {
+    esp_websocket_client_handle_t client = pvParameters;
+    FILE *file = host_gateway_path == NULL || strcmp(host_gateway_path, "-") == 0 ? stdin : fopen(host_gateway_path, "r");
+    if (file == NULL) {
+        ESP_LOGE(TAG, "Unable to open %s", host_gateway_path);
+        host_gateway_event(client, WEBSOCKET_EVENT_ERROR, NULL, 0);
+    } else {
+        client->connected = true;
+        host_gateway_event(client, WEBSOCKET_EVENT_CONNECTED, NULL, 0);
+        ssize_t len;
+        while ((len = getline(&client->line, &client->line_size, file)) >= 0) {
+            while (len > 0 && (client->line[len - 1] == '\n' || client->line[len - 1] == '\r')) {
+                client->line[--len] = '\0';
+            }
+            if (len == 0 || client->line[0] == '#') {
+                continue;
+            }
+            if (host_gateway_queue != NULL) {
+                host_queue_wait_space(host_gateway_queue);
+            }
+            host_gateway_event(client, WEBSOCKET_EVENT_DATA, client->line, len);
+            host_gateway_frames++;
+        }
+        if (file != stdin) {
+            fclose(file);
+        }
+        ESP_LOGI(TAG, "Replayed %u frames", host_gateway_frames);
+    }
+    xSemaphoreGive(host_gateway_done);
+    vTaskDelete(NULL);
+}
+
+esp_websocket_client_handle_t esp_websocket_client_init(const esp_websocket_client_config_t *config) {
+    esp_websocket_client_handle_t client = calloc(1, sizeof(struct esp_websocket_client));
+    if (client != NULL) {
+        client->config = *config;
+    }
+    return client;
+}
+
+esp_err_t esp_websocket_register_events(esp_websocket_client_handle_t client, esp_websocket_event_id_t event, esp_event_handler_t handler,
+                                        void *handler_args) {
+    client->handler = handler;
+    client->handler_args = handler_args;
+    return ESP_OK;
+}
+
+esp_err_t esp_websocket_client_start(esp_websocket_client_handle_t client) {
+    if (host_gateway_done == NULL) {
+        ESP_LOGE(TAG, "Nothing to replay, call host_gateway_replay first");
+        return ESP_ERR_INVALID_STATE;
+    }
+    return xTaskCreate(host_gateway_task, "websocket_task", 0, client, 5, NULL) == pdPASS ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_websocket_client_stop(esp_websocket_client_handle_t client) {
+    client->connected = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_websocket_client_destroy(esp_websocket_client_handle_t client) {
+    free(client->line);
+    free(client);
+    return ESP_OK;
+}
+
+bool esp_websocket_client_is_connected(esp_websocket_client_handle_t client) {
+    return client != NULL && client->connected;
+}
+
+// Gateway payloads the bot sends go to stdout, one per line
+int esp_websocket_client_send_text(esp_websocket_client_handle_t client, const char *data, int len, TickType_t timeout) {
+    printf("WS %.*s\n", len, data);
+    fflush(stdout);
+    return len;
+}
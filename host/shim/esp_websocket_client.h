@@ -0,0 +1,57 @@
+// Stands in for esp_websocket_client_mod.c, frames are replayed from a file instead of read from the gateway
+// Each line of the file is one frame, empty lines and lines starting with # are skipped
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_event.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+typedef struct esp_websocket_client *esp_websocket_client_handle_t;
+
+ESP_EVENT_DECLARE_BASE(WEBSOCKET_EVENTS);
+
+typedef enum {
+    WEBSOCKET_EVENT_ANY = -1,
+    WEBSOCKET_EVENT_ERROR = 0,
+    WEBSOCKET_EVENT_CONNECTED,
+    WEBSOCKET_EVENT_DISCONNECTED,
+    WEBSOCKET_EVENT_DATA,
+    WEBSOCKET_EVENT_MAX
+} esp_websocket_event_id_t;
+
+typedef struct {
+    const char *data_ptr;
+    int data_len;
+    uint8_t op_code;
+    esp_websocket_client_handle_t client;
+    void *user_context;
+    int payload_len;
+    int payload_offset;
+} esp_websocket_event_data_t;
+
+typedef struct {
+    const char *uri;
+    bool disable_auto_reconnect;
+    void *user_context;
+    int buffer_size;
+    bool shared_tls;
+} esp_websocket_client_config_t;
+
+esp_websocket_client_handle_t esp_websocket_client_init(const esp_websocket_client_config_t *config);
+esp_err_t esp_websocket_register_events(esp_websocket_client_handle_t client, esp_websocket_event_id_t event, esp_event_handler_t handler,
+                                        void *handler_args);
+esp_err_t esp_websocket_client_start(esp_websocket_client_handle_t client);
+esp_err_t esp_websocket_client_stop(esp_websocket_client_handle_t client);
+esp_err_t esp_websocket_client_destroy(esp_websocket_client_handle_t client);
+bool esp_websocket_client_is_connected(esp_websocket_client_handle_t client);
+int esp_websocket_client_send_text(esp_websocket_client_handle_t client, const char *data, int len, TickType_t timeout);
+
+// Host only, set before the client starts
+// A frame is only handed over once queue has room, so nothing is dropped however fast the file is read
+void host_gateway_replay(const char *path, QueueHandle_t queue);
+// Blocks until every frame was handed over, returns how many there were
+uint32_t host_gateway_wait(void);
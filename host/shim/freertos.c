@@ -0,0 +1,456 @@
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "freertos/timers.h"
+
+// Semaphores are queues of zero sized items, as in FreeRTOS
+struct host_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    uint8_t *storage;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head; // index of the oldest item
+    UBaseType_t count;
+    bool owned; // storage and the queue itself were allocated here
+    pthread_cond_t idle;
+    UBaseType_t serving; // receivers that took an item and have not asked for the next one yet
+    host_queue_stats_t stats;
+};
+
+_Static_assert(sizeof(struct host_queue) <= sizeof(StaticQueue_t), "StaticQueue_t is too small");
+
+__thread uint64_t host_thread_allocs;
+
+// The item queue this thread last received from, the time it took is service time until it receives again
+static __thread QueueHandle_t host_serving_queue;
+static __thread uint64_t host_serving_since_ns;
+static __thread uint64_t host_serving_allocs;
+
+static uint64_t host_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+struct host_task {
+    TaskFunction_t task;
+    void *arg;
+    char name[16]; // pthread names are this short
+};
+
+static void host_deadline(struct timespec *deadline, TickType_t wait) {
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    deadline->tv_sec += wait / 1000;
+    deadline->tv_nsec += (long)(wait % 1000) * 1000000;
+    if (deadline->tv_nsec >= 1000000000) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000;
+    }
+}
+
+// Waits on cond until ready is true or wait runs out, the lock is held on return
+static bool host_wait(pthread_cond_t *cond, pthread_mutex_t *lock, TickType_t wait, bool (*ready)(QueueHandle_t), QueueHandle_t queue) {
+    if (ready(queue)) {
+        return true;
+    }
+    if (wait == 0) {
+        return false;
+    }
+    struct timespec deadline;
+    host_deadline(&deadline, wait);
+    while (!ready(queue)) {
+        if (wait == portMAX_DELAY) {
+            pthread_cond_wait(cond, lock);
+        } else if (pthread_cond_timedwait(cond, lock, &deadline) == ETIMEDOUT) {
+            return ready(queue);
+        }
+    }
+    return true;
+}
+
+static bool host_queue_has_items(QueueHandle_t queue) {
+    return queue->count > 0;
+}
+
+static bool host_queue_has_space(QueueHandle_t queue) {
+    return queue->count < queue->length;
+}
+
+static void host_queue_setup(QueueHandle_t queue, UBaseType_t length, UBaseType_t item_size, uint8_t *storage) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->not_empty, &attr);
+    pthread_cond_init(&queue->not_full, &attr);
+    pthread_cond_init(&queue->idle, &attr);
+    pthread_condattr_destroy(&attr);
+    queue->storage = storage;
+    queue->length = length;
+    queue->item_size = item_size;
+    queue->head = 0;
+    queue->count = 0;
+    queue->serving = 0;
+    queue->stats = (host_queue_stats_t){0};
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    QueueHandle_t queue = calloc(1, sizeof(struct host_queue) + (size_t)length * item_size);
+    if (queue == NULL) {
+        return NULL;
+    }
+    host_queue_setup(queue, length, item_size, (uint8_t *)(queue + 1));
+    queue->owned = true;
+    return queue;
+}
+
+QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t item_size, uint8_t *storage, StaticQueue_t *buffer) {
+    QueueHandle_t queue = (QueueHandle_t)buffer;
+    host_queue_setup(queue, length, item_size, storage);
+    queue->owned = false;
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_cond_destroy(&queue->not_full);
+    pthread_cond_destroy(&queue->idle);
+    if (queue->owned) {
+        free(queue);
+    }
+}
+
+static BaseType_t host_queue_send(QueueHandle_t queue, const void *item, TickType_t wait, bool front) {
+    pthread_mutex_lock(&queue->lock);
+    bool sent = host_wait(&queue->not_full, &queue->lock, wait, host_queue_has_space, queue);
+    if (sent) {
+        UBaseType_t slot;
+        if (front) {
+            queue->head = (queue->head + queue->length - 1) % queue->length;
+            slot = queue->head;
+        } else {
+            slot = (queue->head + queue->count) % queue->length;
+        }
+        if (queue->item_size > 0) {
+            memcpy(queue->storage + (size_t)slot * queue->item_size, item, queue->item_size);
+        }
+        queue->count++;
+        queue->stats.sent++;
+        pthread_cond_signal(&queue->not_empty);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return sent ? pdPASS : errQUEUE_FULL;
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t wait) {
+    return host_queue_send(queue, item, wait, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t wait) {
+    return host_queue_send(queue, item, wait, true);
+}
+
+// Only receives that may block count as serving, those are the loops a task is built around
+// Semaphores and queues polled on the side, like the HTTP queue when dropping the oldest request, are left out
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait) {
+    pthread_mutex_lock(&queue->lock);
+    if (host_serving_queue == queue) {
+        host_serving_queue = NULL;
+        queue->stats.service_ns += host_now_ns() - host_serving_since_ns;
+        queue->stats.service_allocs += host_thread_allocs - host_serving_allocs;
+        queue->serving--;
+        pthread_cond_broadcast(&queue->idle);
+    }
+    bool received = host_wait(&queue->not_empty, &queue->lock, wait, host_queue_has_items, queue);
+    if (received) {
+        if (queue->item_size > 0) {
+            memcpy(item, queue->storage + (size_t)queue->head * queue->item_size, queue->item_size);
+            queue->stats.received++;
+        }
+        if (queue->item_size > 0 && wait > 0 && host_serving_queue == NULL) {
+            queue->serving++;
+            host_serving_queue = queue;
+            host_serving_since_ns = host_now_ns();
+            host_serving_allocs = host_thread_allocs;
+        }
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+        pthread_cond_broadcast(&queue->not_full); // host_queue_wait_space may be waiting next to a sender
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return received ? pdPASS : pdFAIL;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    pthread_mutex_lock(&queue->lock);
+    UBaseType_t count = queue->count;
+    pthread_mutex_unlock(&queue->lock);
+    return count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue) {
+    pthread_mutex_lock(&queue->lock);
+    UBaseType_t spaces = queue->length - queue->count;
+    pthread_mutex_unlock(&queue->lock);
+    return spaces;
+}
+
+void host_queue_wait_space(QueueHandle_t queue) {
+    pthread_mutex_lock(&queue->lock);
+    host_wait(&queue->not_full, &queue->lock, portMAX_DELAY, host_queue_has_space, queue);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+static bool host_queue_is_idle(QueueHandle_t queue) {
+    return queue->count == 0 && queue->serving == 0;
+}
+
+void host_queue_wait_idle(QueueHandle_t queue) {
+    pthread_mutex_lock(&queue->lock);
+    host_wait(&queue->idle, &queue->lock, portMAX_DELAY, host_queue_is_idle, queue);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+void host_queue_stats(QueueHandle_t queue, host_queue_stats_t *stats, bool reset) {
+    pthread_mutex_lock(&queue->lock);
+    *stats = queue->stats;
+    if (reset) {
+        queue->stats = (host_queue_stats_t){0};
+    }
+    pthread_mutex_unlock(&queue->lock);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial) {
+    SemaphoreHandle_t semaphore = xQueueCreate(max, 0);
+    if (semaphore != NULL) {
+        semaphore->count = initial;
+    }
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCountingStatic(UBaseType_t max, UBaseType_t initial, StaticSemaphore_t *buffer) {
+    SemaphoreHandle_t semaphore = xQueueCreateStatic(max, 0, NULL, buffer);
+    semaphore->count = initial;
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    return xSemaphoreCreateCounting(1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+    return xSemaphoreCreateCounting(1, 0);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t wait) {
+    return xQueueReceive(semaphore, NULL, wait);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    return xQueueSendToBack(semaphore, NULL, 0);
+}
+
+static __thread struct host_task *host_current_task;
+
+static void *host_task_main(void *arg) {
+    host_current_task = arg;
+    pthread_setname_np(pthread_self(), host_current_task->name); // shows up in perf and gdb
+    host_current_task->task(host_current_task->arg);
+    free(host_current_task);
+    return NULL;
+}
+
+static TaskHandle_t host_task_start(TaskFunction_t function, const char *name, void *arg) {
+    struct host_task *task = calloc(1, sizeof(struct host_task)); // freed when the task ends
+    if (task == NULL) {
+        return NULL;
+    }
+    task->task = function;
+    task->arg = arg;
+    snprintf(task->name, sizeof(task->name), "%s", name);
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_t thread;
+    int err = pthread_create(&thread, &attr, host_task_main, task);
+    pthread_attr_destroy(&attr);
+    if (err != 0) {
+        free(task);
+        return NULL;
+    }
+    return task; // only compared against NULL, the task may be gone already
+}
+
+BaseType_t xTaskCreate(TaskFunction_t task, const char *name, uint32_t stack, void *arg, UBaseType_t priority, TaskHandle_t *handle) {
+    TaskHandle_t created = host_task_start(task, name, arg);
+    if (handle != NULL) {
+        *handle = created;
+    }
+    return created != NULL ? pdPASS : pdFAIL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char *name, uint32_t stack, void *arg, UBaseType_t priority,
+                                   TaskHandle_t *handle, BaseType_t core) {
+    return xTaskCreate(task, name, stack, arg, priority, handle);
+}
+
+TaskHandle_t xTaskCreateStatic(TaskFunction_t task, const char *name, uint32_t stack, void *arg, UBaseType_t priority, StackType_t *stack_buffer,
+                               StaticTask_t *task_buffer) {
+    return host_task_start(task, name, arg);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task == NULL) {
+        free(host_current_task);
+        pthread_exit(NULL);
+    }
+}
+
+void vTaskDelay(TickType_t ticks) {
+    struct timespec delay = {.tv_sec = ticks / 1000, .tv_nsec = (long)(ticks % 1000) * 1000000};
+    while (nanosleep(&delay, &delay) != 0 && errno == EINTR)
+        ;
+}
+
+TickType_t xTaskGetTickCount(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (TickType_t)(now.tv_sec * 1000 + now.tv_nsec / 1000000);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    return host_current_task;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+    return 0;
+}
+
+BaseType_t xPortGetCoreID(void) {
+    return sched_getcpu() > 0 ? 1 : 0;
+}
+
+struct host_timer {
+    struct host_timer *next; // in the list of all timers
+    TimerCallbackFunction_t callback;
+    void *id;
+    TickType_t period;
+    TickType_t expires;
+    bool reload;
+    bool active;
+    bool deleted;
+};
+
+static pthread_mutex_t host_timer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t host_timer_changed;
+static pthread_once_t host_timer_once = PTHREAD_ONCE_INIT;
+static struct host_timer *host_timers;
+
+static void host_timer_task(void *arg) {
+    pthread_mutex_lock(&host_timer_lock);
+    for (;;) {
+        TickType_t now = xTaskGetTickCount();
+        struct host_timer *due = NULL;
+        TickType_t next = portMAX_DELAY;
+        for (struct host_timer **link = &host_timers; *link != NULL;) {
+            struct host_timer *timer = *link;
+            if (timer->deleted) {
+                *link = timer->next;
+                free(timer);
+                continue;
+            }
+            if (timer->active && (int32_t)(timer->expires - now) <= 0 && due == NULL) {
+                due = timer;
+            } else if (timer->active && (next == portMAX_DELAY || (int32_t)(timer->expires - next) < 0)) {
+                next = timer->expires;
+            }
+            link = &timer->next;
+        }
+        if (due != NULL) {
+            due->active = due->reload;
+            due->expires = now + due->period;
+            pthread_mutex_unlock(&host_timer_lock);
+            due->callback(due);
+            pthread_mutex_lock(&host_timer_lock);
+        } else if (next == portMAX_DELAY) {
+            pthread_cond_wait(&host_timer_changed, &host_timer_lock);
+        } else {
+            struct timespec deadline;
+            host_deadline(&deadline, next - now);
+            pthread_cond_timedwait(&host_timer_changed, &host_timer_lock, &deadline);
+        }
+    }
+}
+
+static void host_timer_start_task(void) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&host_timer_changed, &attr);
+    pthread_condattr_destroy(&attr);
+    xTaskCreate(host_timer_task, "Tmr Svc", 0, NULL, 0, NULL);
+}
+
+TimerHandle_t xTimerCreate(const char *name, TickType_t period, UBaseType_t reload, void *id, TimerCallbackFunction_t callback) {
+    pthread_once(&host_timer_once, host_timer_start_task);
+    struct host_timer *timer = calloc(1, sizeof(struct host_timer));
+    if (timer == NULL) {
+        return NULL;
+    }
+    timer->callback = callback;
+    timer->id = id;
+    timer->period = period;
+    timer->reload = reload;
+    pthread_mutex_lock(&host_timer_lock);
+    timer->next = host_timers;
+    host_timers = timer;
+    pthread_mutex_unlock(&host_timer_lock);
+    return timer;
+}
+
+static BaseType_t host_timer_update(TimerHandle_t timer, TickType_t period, bool active, bool deleted) {
+    pthread_mutex_lock(&host_timer_lock);
+    timer->period = period;
+    timer->active = active;
+    timer->deleted = deleted;
+    timer->expires = xTaskGetTickCount() + period;
+    pthread_cond_signal(&host_timer_changed);
+    pthread_mutex_unlock(&host_timer_lock);
+    return pdPASS;
+}
+
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t wait) {
+    return host_timer_update(timer, timer->period, true, false);
+}
+
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t wait) {
+    return host_timer_update(timer, timer->period, false, false);
+}
+
+BaseType_t xTimerReset(TimerHandle_t timer, TickType_t wait) {
+    return host_timer_update(timer, timer->period, true, false);
+}
+
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t wait) {
+    return host_timer_update(timer, period, true, false);
+}
+
+// Freed by the timer task, a callback that is running keeps a valid handle
+BaseType_t xTimerDelete(TimerHandle_t timer, TickType_t wait) {
+    return host_timer_update(timer, timer->period, false, true);
+}
+
+void *pvTimerGetTimerID(TimerHandle_t timer) {
+    return timer->id;
+}
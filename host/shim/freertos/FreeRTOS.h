@@ -0,0 +1,43 @@
+// FreeRTOS on top of pthreads, only what the bot uses
+// A tick is a millisecond, priorities and stack sizes are accepted and ignored
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint8_t StackType_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdFAIL 0
+#define pdPASS 1
+#define errQUEUE_FULL 0
+#define portMAX_DELAY UINT32_MAX
+#define configTICK_RATE_HZ 1000
+#define configMAX_TASK_NAME_LEN 16
+#define portTICK_PERIOD_MS 1
+#define portNUM_PROCESSORS 2 // xPortGetCoreID splits the host CPUs in two like the ESP32
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define BIT0 (1 << 0)
+
+typedef void (*TaskFunction_t)(void *);
+typedef struct host_task *TaskHandle_t;
+typedef struct host_queue *QueueHandle_t;
+typedef QueueHandle_t SemaphoreHandle_t;
+
+// Big enough for the queue and task the shim keeps in them
+typedef struct {
+    uint64_t opaque[40];
+} StaticQueue_t;
+typedef StaticQueue_t StaticSemaphore_t;
+typedef struct {
+    uint64_t opaque[8];
+} StaticTask_t;
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t item_size, uint8_t *storage, StaticQueue_t *buffer);
+void vQueueDelete(QueueHandle_t queue);
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t wait);
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t wait);
+#define xQueueSend xQueueSendToBack
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue);
+
+// Host only, blocks until the queue has room, so a replay can run as fast as the queue is drained
+void host_queue_wait_space(QueueHandle_t queue);
+
+// Host only, what receivers did with the items of a queue
+// Service is the time from taking an item to asking for the next one, the allocations are counted by bench/alloc.c
+typedef struct host_queue_stats {
+    uint32_t sent;
+    uint32_t received;
+    uint64_t service_ns;
+    uint64_t service_allocs;
+} host_queue_stats_t;
+
+extern __thread uint64_t host_thread_allocs; // allocations made by this thread, stays 0 unless the allocator counts
+
+// Blocks until the queue is empty and every item taken from it was served
+void host_queue_wait_idle(QueueHandle_t queue);
+void host_queue_stats(QueueHandle_t queue, host_queue_stats_t *stats, bool reset);
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+BaseType_t xTaskCreate(TaskFunction_t task, const char *name, uint32_t stack, void *arg, UBaseType_t priority, TaskHandle_t *handle);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char *name, uint32_t stack, void *arg, UBaseType_t priority,
+                                   TaskHandle_t *handle, BaseType_t core);
+TaskHandle_t xTaskCreateStatic(TaskFunction_t task, const char *name, uint32_t stack, void *arg, UBaseType_t priority, StackType_t *stack_buffer,
+                               StaticTask_t *task_buffer);
+void vTaskDelete(TaskHandle_t task); // only NULL, the calling task
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void); // NULL on threads the shim did not start
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+BaseType_t xPortGetCoreID(void);
@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+# Turns the TRACE lines the bot prints on the trace command, or bot_host -t, into latency histograms per stage
+# Reads a console log from a file or stdin, anything that is not a TRACE line is skipped
+#
+#   idf.py monitor | tee console.log, then send the trace command
+#   host/trace.py console.log --chrome trace.json, and open trace.json in chrome://tracing or ui.perfetto.dev
+import argparse
+import json
+import sys
+from collections import defaultdict
+
+PAYLOAD = 1 << 63  # ids of gateway payloads the bot sent, they are not snowflakes
+WRAP = 1 << 32     # the device keeps the low 32 bits of the microsecond timer
+
+
+def parse(lines):
+    stages = {}
+    records = []  # (core, stage, time_us, id), each dump is unwrapped on its own
+    lost = 0
+    dump = []
+    for line in lines:
+        fields = line.split()
+        if not fields or not fields[0].startswith("TRACE"):
+            continue
+        kind = fields[0]
+        if kind == "TRACE-BEGIN":
+            dump = []
+        elif kind == "TRACE-STAGE" and len(fields) == 3:
+            stages[int(fields[1])] = fields[2]
+        elif kind == "TRACE" and len(fields) == 5:
+            dump.append(tuple(int(field) for field in fields[1:]))
+        elif kind == "TRACE-LOST" and len(fields) == 3:
+            lost += int(fields[2])
+        elif kind == "TRACE-END":
+            records.extend(unwrap(dump))
+            dump = []
+    records.extend(unwrap(dump))  # a log that was cut off before the end
+    return stages, records, lost
+
+
+# Times are relative to the oldest record of the dump, a dump never spans more than one wrap
+def unwrap(dump):
+    if not dump:
+        return []
+    base = min(dump, key=lambda record: record[2])[2]
+    newest = max(record[2] for record in dump)
+    if newest - base > WRAP // 2:  # the timer wrapped, the small times are the newest
+        base = min((record[2] for record in dump if record[2] > WRAP // 2), default=base)
+    return [(core, stage, (time_us - base) % WRAP, id) for core, stage, time_us, id in dump]
+
+
+# Every message gives one sample per pair of consecutive stages it went through
+def transitions(records):
+    by_id = defaultdict(list)
+    for core, stage, time_us, id in records:
+        if id != 0:
+            by_id[id].append((time_us, stage))
+    samples = defaultdict(list)
+    totals = []
+    for id, points in by_id.items():
+        points.sort()
+        for (start, a), (end, b) in zip(points, points[1:]):
+            samples[(a, b)].append(end - start)
+        if not id & PAYLOAD and len(points) > 1:
+            totals.append(points[-1][0] - points[0][0])
+    return samples, totals, len(by_id)
+
+
+def percentile(values, p):
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+def histogram(values, width=40):
+    buckets = defaultdict(int)
+    for value in values:
+        buckets[max(value, 1).bit_length() - 1] += 1
+    most = max(buckets.values())
+    for bucket in range(min(buckets), max(buckets) + 1):
+        count = buckets[bucket]
+        print(f"    {1 << bucket:>10} us {count:>7} {'#' * (count * width // most)}")
+
+
+def report(name, values):
+    values = sorted(values)
+    print(f"{name}: {len(values)} samples, p50 {percentile(values, 50)} us, p90 {percentile(values, 90)} us, "
+          f"p99 {percentile(values, 99)} us, max {values[-1]} us")
+    histogram(values)
+    print()
+
+
+def chrome(records, stages, path):
+    events = []
+    for core, stage, time_us, id in sorted(records, key=lambda record: record[2]):
+        events.append({
+            "name": stages.get(stage, str(stage)),
+            "ph": "i",
+            "s": "t",
+            "ts": time_us,
+            "pid": 0,
+            "tid": core,
+            "args": {"id": str(id & ~PAYLOAD), "payload": bool(id & PAYLOAD)},
+        })
+    # One span per message from its first to its last stage, on its own row
+    by_id = defaultdict(list)
+    for core, stage, time_us, id in records:
+        if id != 0:
+            by_id[id].append((time_us, stage))
+    for id, points in by_id.items():
+        points.sort()
+        label = f"payload {id & ~PAYLOAD}" if id & PAYLOAD else f"message {id}"
+        for (start, a), (end, b) in zip(points, points[1:]):
+            events.append({
+                "name": f"{stages.get(a, a)} -> {stages.get(b, b)}",
+                "ph": "X",
+                "ts": start,
+                "dur": end - start,
+                "pid": 1,
+                "tid": label,
+            })
+    with open(path, "w") as out:
+        json.dump({"traceEvents": events, "displayTimeUnit": "ms"}, out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Latency per stage from the bot's TRACE lines")
+    parser.add_argument("log", nargs="?", default="-", help="console log, - for stdin")
+    parser.add_argument("--chrome", metavar="FILE", help="also write Chrome trace JSON")
+    args = parser.parse_args()
+
+    source = sys.stdin if args.log == "-" else open(args.log, errors="replace")
+    stages, records, lost = parse(source)
+    if not records:
+        print("No TRACE lines found", file=sys.stderr)
+        return 1
+
+    samples, totals, messages = transitions(records)
+    print(f"{len(records)} records, {messages} messages, {lost} records lost to full rings\n")
+    for a, b in sorted(samples, key=lambda pair: (pair[0], pair[1])):
+        report(f"{stages.get(a, a)} -> {stages.get(b, b)}", samples[(a, b)])
+    if totals:
+        report("first -> last stage of a message", totals)
+    if args.chrome:
+        chrome(records, stages, args.chrome)
+        print(f"Wrote {args.chrome}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
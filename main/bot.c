@@ -15,22 +15,27 @@
 #include "jsmn.h"
 #include "nvs_flash.h"
 
+#include "bot_cache.c"
+#include "bot_intern.c"
 #include "bot_cmd_manager.c"
 #include "discord.h"
 #include "heart.c"
 #include "helper.h"
+#include "jsonEscape.h"
+#include "jsonTemplate.h"
+#include "mem_place.h"
+#include "trace.h"
 
-#define JSMN_TOKEN_LENGTH 256
+#define JSMN_TOKEN_LENGTH CONFIG_BOT_JSMN_TOKENS
 #define BOT_TOKEN CONFIG_BOT_TOKEN
 #define BOT_PREFIX CONFIG_BOT_PREFIX
-#define BOT_PREFIX_LENGTH strlen(BOT_PREFIX)
+#define BOT_PREFIX_LENGTH (sizeof(BOT_PREFIX) - 1)
 #define BOT_BUFFER_SIZE CONFIG_WEBSOCKET_BUFFER_SIZE
+#define BOT_ITEM_SIZE (BOT_BUFFER_SIZE + 1 + TRACE_STAMP_SIZE) // a gateway queue item, see websocket.c
+#define BOT_MAX_MEMBER_ROLES 32 // roles of a member past this are not looked at
 #define BOT_CASE_SENSITIVE CONFIG_BOT_CASE_SENSITIVE
-#ifdef CONFIG_BOT_HELP
-#define BOT_HELP_STRING "Use any of the following after " BOT_PREFIX "\\n```help: Show this message\\n" CONFIG_BOT_HELP_STRING "```"
 #ifdef CONFIG_BOT_BASIC_HELP
-#define BOT_BASIC_HELP "If you need my help, use the following command\\n```" BOT_PREFIX " help```"
-#endif
+#define BOT_BASIC_HELP "If you need my help, use the following command\n```" BOT_PREFIX " help```"
 #endif
 
 // IMPROVE: reconnect bot every now and then to reset sequence number to avoid huge seq numbers
@@ -40,45 +45,94 @@ typedef void (*BOT_payload_handler)(char *); // function that will send the bot
 static const char BOT_TAG[] = "Bot";
 static const char JSM_TAG[] = "JSMN";
 
-// No reason to build the login json
-static const char LOGIN_STR[] = "{\"op\":2,\"d\":{\"token\":\"%s\",\"properties\":{\"$os\":\"FreeRTOS\",\"$browser\":\"ESP_HTTP_CLIENT\",\"$device\":\"ESP32\"},\"compress\":true,\"large_threshold\":50,\"shard\":[0,1],\"presence\":{\"status\":\"online\",\"afk\":false},\"guild_subscriptions\":true,\"intents\":512}}";
-static const char HB_STR[] = "{\"op\": 1,\"d\": \"%s\"}";
-static const char BOT_MENTION_PATTERN[] = "<@%s>";
+// Fixed payloads are split into literals and slots once, sending them is only copying
+static const json_segment_t LOGIN_TPL[] = {
+    JSON_LITERAL("{\"op\":2,\"d\":{\"token\":"),
+    JSON_SLOT(JSON_SLOT_STRING, 0),
+    JSON_LITERAL(",\"properties\":{\"$os\":\"FreeRTOS\",\"$browser\":\"ESP_HTTP_CLIENT\",\"$device\":\"ESP32\"},\"compress\":true,\"large_threshold\":50,\"shard\":[0,1],\"presence\":{\"status\":\"online\",\"afk\":false},\"guild_subscriptions\":true,\"intents\":513}}"), // guilds and guild messages
+};
+static const json_segment_t HB_TPL[] = {
+    JSON_LITERAL("{\"op\":1,\"d\":"),
+    JSON_SLOT(JSON_SLOT_RAW, 0), // the sequence number or null, discord does not accept it quoted
+    JSON_LITERAL("}"),
+};
 
 static jsmn_parser parser;
 static jsmntok_t tkns[JSMN_TOKEN_LENGTH]; // IMPROVE: use dynamic token buffer
-static char data_ptr[BOT_BUFFER_SIZE];
-static char payload_ptr[BOT_BUFFER_SIZE]; // IMPROVE: use semaphore instead of double buffer
+static char *data_ptr;    // BOT_ITEM_SIZE, placed on init
+static char *payload_ptr; // IMPROVE: use semaphore instead of double buffer
 SemaphoreHandle_t xPayload_sema;
 
 enum payload_event { // What event did we receive
     EVENT_NULL,
     EVENT_READY,
-    EVENT_GUILD_OBJ,
+    EVENT_GUILD_OBJ, // created or updated
+    EVENT_GUILD_DELETE,
+    EVENT_CHANNEL, // created or updated
+    EVENT_CHANNEL_DELETE,
+    EVENT_ROLE, // created or updated
+    EVENT_ROLE_DELETE,
     MESSAGE_CREATE,
 };
 typedef enum payload_event payload_event;
 
+// Event names are interned once, the name in a payload is only looked up
+typedef struct BOT_event_name {
+    const char *name;
+    payload_event event;
+} BOT_event_name_t;
+
+static const BOT_event_name_t BOT_event_names[] = {
+    {"READY", EVENT_READY},
+    {"GUILD_CREATE", EVENT_GUILD_OBJ},
+    {"GUILD_UPDATE", EVENT_GUILD_OBJ},
+    {"GUILD_DELETE", EVENT_GUILD_DELETE},
+    {"CHANNEL_CREATE", EVENT_CHANNEL},
+    {"CHANNEL_UPDATE", EVENT_CHANNEL},
+    {"CHANNEL_DELETE", EVENT_CHANNEL_DELETE},
+    {"GUILD_ROLE_CREATE", EVENT_ROLE},
+    {"GUILD_ROLE_UPDATE", EVENT_ROLE},
+    {"GUILD_ROLE_DELETE", EVENT_ROLE_DELETE},
+    {"MESSAGE_CREATE", MESSAGE_CREATE},
+};
+
+#define BOT_EVENT_COUNT (sizeof(BOT_event_names) / sizeof(BOT_event_names[0]))
+
+static BOT_str_t BOT_event_handles[BOT_EVENT_COUNT];
+
 static QueueHandle_t BOT_message_queue;
 static BOT_payload_handler BOT_payload_handle;
 static payload_event BOT_event = EVENT_NULL;
 static char *BOT_session_id;
+static char BOT_mention[BOT_ID_LENGTH + 3];      // <@id>, empty until READY
+static char BOT_mention_nick[BOT_ID_LENGTH + 4]; // <@!id>, how mentions of a member with a nickname look
 // static char *BOT_token = "null";
-static char *BOT_seq; // format as integer, "null" otherwise
+static volatile long BOT_seq = -1; // sent as null until the first dispatch, read by the heartbeat task
 static int BOT_lastOP = -1;
 // static char *BOT_activeGuild = "null";
 // static bool BOT_ready = false;
 static bool BOT_ACK = false;
+static uint32_t BOT_payload_count; // gateway payloads sent, they are traced under it
+#ifdef CONFIG_BOT_BASIC_HELP
+static discord_reply_t *BOT_basic_help_reply; // rendered on init, every !help shares it
+#endif
 
-#define BOT_send_payload(data, len, ...)               \
-    {                                                  \
-        ESP_LOGD(BOT_TAG, "Payload waiting");          \
-        vTaskDelay(pdMS_TO_TICKS(550));                \
-        xSemaphoreTake(xPayload_sema, portMAX_DELAY);  \
-        snprintf(payload_ptr, len, data, __VA_ARGS__); \
-        BOT_payload_handle(payload_ptr);               \
-        xSemaphoreGive(xPayload_sema);                 \
-        ESP_LOGD(BOT_TAG, "Payload done");             \
+#define BOT_send_payload(tpl, ...)                                                                                   \
+    {                                                                                                                \
+        const json_slot_t values[] = {__VA_ARGS__};                                                                  \
+        uint64_t trace_id = TRACE_PAYLOAD | __atomic_add_fetch(&BOT_payload_count, 1, __ATOMIC_RELAXED);            \
+        ESP_LOGD(BOT_TAG, "Payload waiting");                                                                        \
+        trace_point(TRACE_PAYLOAD_WAIT, trace_id);                                                                   \
+        vTaskDelay(pdMS_TO_TICKS(550));                                                                              \
+        xSemaphoreTake(xPayload_sema, portMAX_DELAY);                                                                \
+        if (json_template_render(tpl, JSON_TEMPLATE_LENGTH(tpl), values, payload_ptr, BOT_BUFFER_SIZE) >= 0) {       \
+            BOT_payload_handle(payload_ptr);                                                                         \
+            trace_point(TRACE_PAYLOAD_SENT, trace_id);                                                               \
+        } else {                                                                                                     \
+            ESP_LOGE(BOT_TAG, "Payload does not fit in %d bytes", BOT_BUFFER_SIZE);                                 \
+        }                                                                                                            \
+        xSemaphoreGive(xPayload_sema);                                                                               \
+        ESP_LOGD(BOT_TAG, "Payload done");                                                                           \
     }
 
 static void BOT_set_session_id(char *new_id) {
@@ -87,10 +141,18 @@ static void BOT_set_session_id(char *new_id) {
     BOT_session_id = strdup(new_id); // IMPROVE: Does this need to be freed?
 }
 
-static void BOT_set_sequence(char *new_seq) {
-    ESP_LOGI(BOT_TAG, "Sequence: %s", new_seq);
-    free(BOT_seq);
-    BOT_seq = strdup(new_seq);
+static void BOT_set_user_id(const char *id, int len) {
+    if (len >= BOT_ID_LENGTH) {
+        return;
+    }
+    snprintf(BOT_mention, sizeof(BOT_mention), "<@%.*s>", len, id);
+    snprintf(BOT_mention_nick, sizeof(BOT_mention_nick), "<@!%.*s>", len, id);
+    ESP_LOGI(BOT_TAG, "Bot mention: %s", BOT_mention);
+}
+
+static void BOT_set_sequence(long seq) {
+    ESP_LOGI(BOT_TAG, "Sequence: %ld", seq);
+    BOT_seq = seq;
 }
 
 static void BOT_set_event(payload_event event) {
@@ -103,8 +165,11 @@ static void BOT_heartbeat_task(void *pvParameters) {
         esp_restart();
     } else {
         BOT_ACK = false; // Expecting ACK to return and set to true before next heartbeat
-        int len = strlen(HB_STR) + strlen(BOT_seq) + 1;
-        BOT_send_payload(HB_STR, len, BOT_seq); // send with sequence number
+        char seq[24] = "null";
+        if (BOT_seq >= 0) {
+            snprintf(seq, sizeof(seq), "%ld", BOT_seq);
+        }
+        BOT_send_payload(HB_TPL, {.string = seq}); // send with sequence number
     }
     vTaskDelete(NULL);
 }
@@ -116,21 +181,20 @@ static void BOT_set_heartbeat_int(int beat) {
 
 static void BOT_do_login_task(void *pvParameters) {
     ESP_LOGI(BOT_TAG, "Sending login info");
-    BOT_send_payload(LOGIN_STR, 480, BOT_TOKEN);
+    BOT_send_payload(LOGIN_TPL, {.string = BOT_TOKEN});
     vTaskDelete(NULL);
 }
 
-static void BOT_new_event(char *event) { // TODO: set all the events that we care about
-    ESP_LOGI(BOT_TAG, "Message event: %s", event);
+static void BOT_new_event(const char *event, int len) { // TODO: set all the events that we care about
+    ESP_LOGI(BOT_TAG, "Message event: %.*s", len, event);
 
-    if (strcmp(event, "READY") == 0) {
-        BOT_set_event(EVENT_READY);
-    } else if (strcmp(event, "GUILD_CREATE") == 0) {
-        BOT_set_event(EVENT_GUILD_OBJ);
-    } else if (strcmp(event, "MESSAGE_CREATE") == 0) {
-        BOT_set_event(MESSAGE_CREATE);
-    } else {
-        BOT_set_event(EVENT_NULL);
+    BOT_str_t handle = BOT_intern_find(event, len);
+    BOT_set_event(EVENT_NULL);
+    for (int i = 0; handle != 0 && i < BOT_EVENT_COUNT; i++) {
+        if (BOT_event_handles[i] == handle) {
+            BOT_set_event(BOT_event_names[i].event);
+            break;
+        }
     }
 }
 
@@ -181,6 +245,15 @@ static bool json_equal(const char *json, jsmntok_t *tok, const char *s) {
     return false;
 }
 
+// Copy a json string token to the heap, unescaped
+static char *json_token_dup(const char *json, jsmntok_t *tok) {
+    int len = tok->end - tok->start;
+    char *string = malloc(len + 1);
+    memcpy(string, json + tok->start, len);
+    json_unescape(string, len);
+    return string;
+}
+
 static bool json_null(const char *json, jsmntok_t *tok) {
     return strncmp(json + tok->start, "null", tok->end - tok->start) == 0;
 }
@@ -220,12 +293,293 @@ static inline int jsmn_get_total_size(jsmntok_t *token) {
     return res;
 }
 
+// Read an id that may be quoted, 0 if it is not one
+static uint64_t json_snowflake(const char *json, jsmntok_t *tok) {
+    uint64_t id;
+    return string_to_u64(json + tok->start, tok->end - tok->start, &id) ? id : 0;
+}
+
+// Unescape a string token into out, cut to fit, returns the length
+static int json_token_copy(const char *json, jsmntok_t *tok, char *out, int size) {
+    int len = tok->end - tok->start;
+    if (len > size - 1) {
+        len = size - 1;
+    }
+    memcpy(out, json + tok->start, len);
+    return json_unescape(out, len);
+}
+
+// Channels in GUILD_CREATE have no guild_id, the guild they came with is used instead
+static void BOT_cache_channel(const char *json, jsmntok_t *object, uint64_t guild_id) {
+    uint64_t id = 0;
+    int type = 0;
+    jsmntok_t *name = NULL;
+    jsmntok_t *tok = object + 1;
+    for (int i = 0; i < object->size; i++) {
+        if (json_equal(json, tok, "id")) {
+            id = json_snowflake(json, tok + 1);
+        } else if (json_equal(json, tok, "guild_id")) {
+            guild_id = json_snowflake(json, tok + 1);
+        } else if (json_equal(json, tok, "type")) {
+            type = atoi(json + tok[1].start);
+        } else if (json_equal(json, tok, "name") && tok[1].type == JSMN_STRING) {
+            name = tok + 1;
+        }
+        tok += jsmn_get_total_size(tok);
+    }
+    if (id != 0 && guild_id != 0) { // direct messages have no guild
+        char buffer[BOT_CACHE_NAME_LENGTH];
+        int len = name != NULL ? json_token_copy(json, name, buffer, sizeof(buffer)) : 0;
+        BOT_cache_put_channel(id, guild_id, type, buffer, len);
+    }
+}
+
+static void BOT_cache_role(const char *json, jsmntok_t *object, uint64_t guild_id) {
+    uint64_t id = 0, permissions = 0;
+    long color = 0, position = 0;
+    jsmntok_t *name = NULL;
+    jsmntok_t *tok = object + 1;
+    for (int i = 0; i < object->size; i++) {
+        if (json_equal(json, tok, "id")) {
+            id = json_snowflake(json, tok + 1);
+        } else if (json_equal(json, tok, "permissions")) { // a string, it does not fit a double
+            permissions = json_snowflake(json, tok + 1);
+        } else if (json_equal(json, tok, "color")) {
+            color = atol(json + tok[1].start);
+        } else if (json_equal(json, tok, "position")) {
+            position = atol(json + tok[1].start);
+        } else if (json_equal(json, tok, "name") && tok[1].type == JSMN_STRING) {
+            name = tok + 1;
+        }
+        tok += jsmn_get_total_size(tok);
+    }
+    if (id != 0 && guild_id != 0) {
+        char buffer[BOT_CACHE_NAME_LENGTH];
+        int len = name != NULL ? json_token_copy(json, name, buffer, sizeof(buffer)) : 0;
+        BOT_cache_put_role(id, guild_id, buffer, len, permissions, color, position);
+    }
+}
+
+// The id may come after the lists, so the guild is stored first and its lists are read in a second pass
+static void BOT_cache_guild(const char *json, jsmntok_t *object) {
+    uint64_t id = 0, owner_id = 0;
+    jsmntok_t *name = NULL;
+    jsmntok_t *tok = object + 1;
+    for (int i = 0; i < object->size; i++) {
+        if (json_equal(json, tok, "id")) {
+            id = json_snowflake(json, tok + 1);
+        } else if (json_equal(json, tok, "owner_id")) {
+            owner_id = json_snowflake(json, tok + 1);
+        } else if (json_equal(json, tok, "name") && tok[1].type == JSMN_STRING) {
+            name = tok + 1;
+        }
+        tok += jsmn_get_total_size(tok);
+    }
+    if (id == 0) {
+        return;
+    }
+    char buffer[BOT_CACHE_NAME_LENGTH];
+    int len = name != NULL ? json_token_copy(json, name, buffer, sizeof(buffer)) : 0;
+    BOT_cache_put_guild(id, buffer, len, owner_id);
+
+    tok = object + 1;
+    for (int i = 0; i < object->size; i++) {
+        bool channels = json_equal(json, tok, "channels");
+        if ((channels || json_equal(json, tok, "roles")) && tok[1].type == JSMN_ARRAY) {
+            jsmntok_t *item = tok + 2;
+            for (int j = 0; j < tok[1].size; j++) {
+                if (item->type == JSMN_OBJECT) {
+                    if (channels) {
+                        BOT_cache_channel(json, item, id);
+                    } else {
+                        BOT_cache_role(json, item, id);
+                    }
+                }
+                item += jsmn_get_token_size(item);
+            }
+        }
+        tok += jsmn_get_total_size(tok);
+    }
+}
+
+// Find the value of a key in an object, NULL if it is not there
+static jsmntok_t *json_object_get(const char *json, jsmntok_t *object, const char *key) {
+    jsmntok_t *tok = object + 1;
+    for (int i = 0; i < object->size; i++) {
+        if (json_equal(json, tok, key)) {
+            return tok + 1;
+        }
+        tok += jsmn_get_total_size(tok);
+    }
+    return NULL;
+}
+
+// Keep the cache current from the data of an event, false if the event is not one it is fed from
+static bool BOT_cache_event(const char *json, jsmntok_t *data) {
+    jsmntok_t *tok;
+    switch (BOT_event) {
+    case EVENT_GUILD_OBJ:
+        BOT_cache_guild(json, data);
+        return true;
+    case EVENT_GUILD_DELETE: // an outage only makes the guild unavailable for a while, it is kept until it comes back
+        tok = json_object_get(json, data, "unavailable");
+        if (tok == NULL || strncmp(json + tok->start, "true", 4) != 0) {
+            tok = json_object_get(json, data, "id");
+            if (tok != NULL) {
+                BOT_cache_remove_guild(json_snowflake(json, tok));
+            }
+        }
+        return true;
+    case EVENT_CHANNEL:
+        BOT_cache_channel(json, data, 0);
+        return true;
+    case EVENT_CHANNEL_DELETE:
+        tok = json_object_get(json, data, "id");
+        if (tok != NULL) {
+            BOT_cache_remove_channel(json_snowflake(json, tok));
+        }
+        return true;
+    case EVENT_ROLE:
+        tok = json_object_get(json, data, "role");
+        if (tok != NULL && tok->type == JSMN_OBJECT) {
+            jsmntok_t *guild = json_object_get(json, data, "guild_id");
+            BOT_cache_role(json, tok, guild != NULL ? json_snowflake(json, guild) : 0);
+        }
+        return true;
+    case EVENT_ROLE_DELETE:
+        tok = json_object_get(json, data, "role_id");
+        if (tok != NULL) {
+            BOT_cache_remove_role(json_snowflake(json, tok));
+        }
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Read the role ids of a member into a sorted set, returns how many there are
+static int BOT_read_roles(const char *json, jsmntok_t *array, uint64_t *roles, int max) {
+    int count = 0;
+    jsmntok_t *tok = array + 1;
+    for (int i = 0; i < array->size && count < max; i++) {
+        uint64_t id = json_snowflake(json, tok);
+        int j = count++;
+        for (; j > 0 && roles[j - 1] > id; j--) {
+            roles[j] = roles[j - 1];
+        }
+        roles[j] = id;
+        tok += jsmn_get_token_size(tok);
+    }
+    return count;
+}
+
+// Work out whether the author is a caster, false if the command needs one and they are not
+static bool BOT_authorize(BOT_basic_message_t *msg, const char *json, jsmntok_t *roles) {
+    uint64_t set[BOT_MAX_MEMBER_ROLES];
+    msg->caster = roles != NULL && msg->guild_id != 0 && msg->author_id != 0 &&
+                  BOT_cache_authorize(msg->guild_id, msg->author_id, set, BOT_read_roles(json, roles, set, BOT_MAX_MEMBER_ROLES));
+
+    const char *args;
+    const BOT_command_t *command = BOT_find_command(msg->content, &args);
+    if (command != NULL && command->caster && !msg->caster) {
+        ESP_LOGW(BOT_TAG, "%llu is not allowed to use %s", (unsigned long long)msg->author_id, command->name);
+        return false;
+    }
+    return true;
+}
+
+static inline bool BOT_starts_with(const char *content, int len, const char *start, int start_len) {
+    return start_len > 0 && len >= start_len && strncmp(content, start, start_len) == 0;
+}
+
+// Length of the prefix or bot mention that a command starts with, 0 if it is not a command
+static int BOT_command_prefix(const char *content, int len) {
+    if (len >= BOT_PREFIX_LENGTH && string_match(content, BOT_PREFIX)) {
+        return BOT_PREFIX_LENGTH;
+    }
+    int mention_len = strlen(BOT_mention);
+    if (BOT_starts_with(content, len, BOT_mention, mention_len)) {
+        return mention_len;
+    }
+    mention_len = strlen(BOT_mention_nick);
+    if (BOT_starts_with(content, len, BOT_mention_nick, mention_len)) {
+        return mention_len;
+    }
+    return 0;
+}
+
+// Most messages are plain chat, they are recognized from the raw payload so they never reach jsmn
+// Walks the payload once keeping track of depth, only the sequence number is taken from chat that is skipped
+static bool BOT_skip_chat(const char *json, int len) {
+    static const char MESSAGE_CREATE_EVENT[] = "\"t\":\"MESSAGE_CREATE\""; // quotes inside strings are escaped, so this only matches the event name
+    if (memmem(json, len, MESSAGE_CREATE_EVENT, sizeof(MESSAGE_CREATE_EVENT) - 1) == NULL) {
+        return false;
+    }
+    const char *content = NULL;
+    int content_len = 0;
+    const char *seq = NULL;
+    int seq_len = 0;
+    int depth = 0;
+    for (int i = 0; i < len && (content == NULL || seq == NULL); i++) {
+        char c = json[i];
+        if (c == '{' || c == '[') {
+            depth++;
+        } else if (c == '}' || c == ']') {
+            depth--;
+        } else if (c == '"') {
+            int start = ++i;
+            while (i < len && json[i] != '"') {
+                if (json[i] == '\\')
+                    i++;
+                i++;
+            }
+            if (i + 1 >= len || json[i + 1] != ':') {
+                continue; // a value, or the payload ended
+            }
+            int key_len = i - start;
+            if (depth == 1 && key_len == 1 && json[start] == 's') { // sequence of the top level payload
+                seq = json + i + 2;
+                while (seq + seq_len < json + len && isdigit((unsigned char)seq[seq_len]))
+                    seq_len++;
+            } else if (depth == 2 && key_len == 7 && strncmp(json + start, "content", 7) == 0 && i + 2 < len && json[i + 2] == '"') {
+                i += 3; // content of the message itself, not of a referenced message deeper down
+                content = json + i;
+                while (i < len && json[i] != '"') {
+                    if (json[i] == '\\')
+                        i++;
+                    i++;
+                }
+                content_len = i - (content - json);
+            }
+        }
+    }
+    if (content == NULL || BOT_command_prefix(content, content_len) > 0) {
+        return false;
+    }
+#ifdef CONFIG_BOT_BASIC_HELP
+    if (content_len >= 5 && string_match(content, "!help")) {
+        return false;
+    }
+#endif
+    if (seq_len > 0 && seq_len < BOT_ID_LENGTH) {
+        BOT_set_sequence(strtol(seq, NULL, 10));
+    }
+    return true;
+}
+
 static void BOT_payload_task(void *pvParameters) {
     for (;;) {
         ESP_LOGI(BOT_TAG, "Waiting for queue");                    // IMPROVE: Only use one queue for BOT task
         xQueueReceive(BOT_message_queue, data_ptr, portMAX_DELAY); // Wait for new message in queue
+        uint32_t received_us = trace_stamp_read(data_ptr + BOT_BUFFER_SIZE + 1);
+        uint32_t taken_us = trace_now();
         int data_len = strlen(data_ptr);
 
+        if (BOT_skip_chat(data_ptr, data_len)) {
+            ESP_LOGD(BOT_TAG, "Skipped chat message");
+            continue;
+        }
+
         jsmn_init(&parser); // IG we gotta reinit everytime?
         int r = jsmn_parse(&parser, data_ptr, data_len, tkns, JSMN_TOKEN_LENGTH);
 
@@ -244,7 +598,8 @@ static void BOT_payload_task(void *pvParameters) {
                 ESP_LOGE(JSM_TAG, "Object expected in JSON");
             }
         } else {
-            BOT_basic_message_t bot_message;
+            BOT_basic_message_t bot_message = {0};
+            jsmntok_t *member_roles = NULL; // checked once the guild and author are known
             msg_set_content(bot_message, "");
             bool voided = false;
             for (size_t i = 1; i < r; i++) {
@@ -253,20 +608,12 @@ static void BOT_payload_task(void *pvParameters) {
                     break;
                 } else if (json_equal(data_ptr, &tkns[i], "t")) { // Event name
                     ESP_LOGD(BOT_TAG, "Get event name");
-                    int len = (tkns[i + 1].end - tkns[i + 1].start) + 1;
-                    char *event = malloc(len);
-                    snprintf(event, len, (char *)(data_ptr + tkns[i + 1].start));
-                    BOT_new_event(event);
-                    free(event);
+                    BOT_new_event(data_ptr + tkns[i + 1].start, tkns[i + 1].end - tkns[i + 1].start);
                     i++; // Skip tokens that we just read
                 } else if (json_equal(data_ptr, &tkns[i], "s")) {
                     ESP_LOGD(BOT_TAG, "Get sequence");
                     if (!json_null(data_ptr, &tkns[i + 1])) {
-                        int len = (tkns[i + 1].end - tkns[i + 1].start) + 1;
-                        char *new_seq = malloc(len);
-                        snprintf(new_seq, len, (char *)(data_ptr + tkns[i + 1].start));
-                        BOT_set_sequence(new_seq);
-                        free(new_seq);
+                        BOT_set_sequence(strtol(data_ptr + tkns[i + 1].start, NULL, 10));
                     }
                     i++; // Skip tokens that we just read
                 } else if (json_equal(data_ptr, &tkns[i], "op")) {
@@ -274,7 +621,7 @@ static void BOT_payload_task(void *pvParameters) {
                     if (!json_null(data_ptr, &tkns[i + 1])) {
                         int len = (tkns[i + 1].end - tkns[i + 1].start) + 1;
                         char *opStr = malloc(len);
-                        snprintf(opStr, len, (char *)(data_ptr + tkns[i + 1].start));
+                        snprintf(opStr, len, "%s", (char *)(data_ptr + tkns[i + 1].start));
                         BOT_op_code(atoi(opStr));
                         free(opStr);
                     }
@@ -286,6 +633,11 @@ static void BOT_payload_task(void *pvParameters) {
                         continue; /* We expect data to be an object */
                     }
 
+                    if (BOT_cache_event(data_ptr, &tkns[i + 1])) {
+                        i += jsmn_get_total_size(&tkns[i]);
+                        continue;
+                    }
+
                     ESP_LOGI(BOT_TAG, "Reading payload data");
 
                     int j;
@@ -300,8 +652,11 @@ static void BOT_payload_task(void *pvParameters) {
                         case MESSAGE_CREATE:
                             if (json_equal(data_ptr, &tkns[k], "member")) {
                                 ESP_LOGD(BOT_TAG, "data: member");
-                                ESP_LOGI(BOT_TAG, "Not checking for caster role"); // TODO: check for caster role
-                                k += jsmn_get_total_size(&tkns[k]);                // Skip the tokens that were in this data block
+                                jsmntok_t *roles = json_object_get(data_ptr, &tkns[k + 1], "roles");
+                                if (roles != NULL && roles->type == JSMN_ARRAY) {
+                                    member_roles = roles;
+                                }
+                                k += jsmn_get_total_size(&tkns[k]); // Skip the tokens that were in this data block
                             } else if (json_equal(data_ptr, &tkns[k], "author")) { // Get author data
                                 ESP_LOGD(BOT_TAG, "data: author");
                                 int l;
@@ -309,45 +664,33 @@ static void BOT_payload_task(void *pvParameters) {
                                 for (l = 0; l < tkns[k + 1].size; l++) {
                                     if (json_equal(data_ptr, &tkns[_k], "username")) {
                                         ESP_LOGD(BOT_TAG, "data: username");
-                                        int len = (tkns[_k + 1].end - tkns[_k + 1].start) + 1;
-                                        char *data = malloc(len);
-                                        snprintf(data, len, (char *)(data_ptr + tkns[_k + 1].start));
-                                        msg_set_author(bot_message, data);
-                                        free(data);
+                                        char name[BOT_CACHE_NAME_LENGTH];
+                                        int len = json_token_copy(data_ptr, &tkns[_k + 1], name, sizeof(name));
+                                        BOT_intern_release(bot_message.author); // in case it is listed twice
+                                        bot_message.author = BOT_intern(name, len);
                                         _k += 2;
                                     } else if (json_equal(data_ptr, &tkns[_k], "id")) {
                                         ESP_LOGD(BOT_TAG, "data: id");
-                                        int len = (tkns[_k + 1].end - tkns[_k + 1].start) + 1;
-                                        char *data = malloc(len);
-                                        snprintf(data, len, (char *)(data_ptr + tkns[_k + 1].start));
-                                        msg_set_author_id(bot_message, data);
-                                        free(data);
-
-                                        len = len + strlen(BOT_MENTION_PATTERN);
-                                        data = malloc(len);
-                                        snprintf(data, len, BOT_MENTION_PATTERN, bot_message.author_id);
-                                        msg_set_author_mention(bot_message, data);
-                                        free(data);
+                                        bot_message.author_id = json_snowflake(data_ptr, &tkns[_k + 1]);
                                         _k += 2;
                                     } else {
                                         _k += jsmn_get_total_size(&tkns[_k]);
                                     }
                                 }
                                 k += jsmn_get_total_size(&tkns[k]); // Skip the tokens that were in this data block
+                            } else if (json_equal(data_ptr, &tkns[k], "id")) {
+                                ESP_LOGD(BOT_TAG, "data: id");
+                                bot_message.id = json_snowflake(data_ptr, &tkns[k + 1]);
+                                k += jsmn_get_total_size(&tkns[k]);
                             } else if (json_equal(data_ptr, &tkns[k], "channel_id")) {
                                 ESP_LOGD(BOT_TAG, "data: channel_id");
-                                int len = (tkns[k + 1].end - tkns[k + 1].start) + 1;
-                                char *data = malloc(len);
-                                snprintf(data, len, (char *)(data_ptr + tkns[k + 1].start));
-                                msg_set_channel_id(bot_message, data);
-                                free(data);
+                                bot_message.channel_id = json_snowflake(data_ptr, &tkns[k + 1]);
                                 k += jsmn_get_total_size(&tkns[k]);
                             } else if (json_equal(data_ptr, &tkns[k], "content")) { // Only accept prefixed content
                                 ESP_LOGD(BOT_TAG, "data: content");
-                                int len = (tkns[k + 1].end - tkns[k + 1].start) + 1;
-                                char *data = malloc(len);
-                                snprintf(data, len, (char *)(data_ptr + tkns[k + 1].start));
-                                if (!string_match(data, BOT_PREFIX)) { // Void if prefix does not exist
+                                char *data = json_token_dup(data_ptr, &tkns[k + 1]);
+                                int prefix = BOT_command_prefix(data, strlen(data));
+                                if (prefix == 0) { // Void if neither the prefix nor a mention of the bot exists
 #ifdef CONFIG_BOT_BASIC_HELP
                                     if (string_match(data, "!help")) {
                                         ESP_LOGI(BOT_TAG, "!help detected, queueing basic help string");
@@ -366,22 +709,18 @@ static void BOT_payload_task(void *pvParameters) {
                                     free(data);
                                     continue;
                                 }
-                                msg_set_content(bot_message, data + BOT_PREFIX_LENGTH); // ignore the prefix
+                                msg_set_content(bot_message, data + prefix); // ignore the prefix
                                 free(data);
                                 k += jsmn_get_total_size(&tkns[k]);
                             } else if (json_equal(data_ptr, &tkns[k], "guild_id")) {
                                 ESP_LOGD(BOT_TAG, "data: guild_id");
-                                int len = (tkns[k + 1].end - tkns[k + 1].start) + 1;
-                                char *data = malloc(len);
-                                snprintf(data, len, (char *)(data_ptr + tkns[k + 1].start));
-                                msg_set_guild_id(bot_message, data);
-                                free(data);
+                                bot_message.guild_id = json_snowflake(data_ptr, &tkns[k + 1]);
                                 k += jsmn_get_total_size(&tkns[k]);
                             } else if (json_equal(data_ptr, &tkns[k], "type")) {
                                 ESP_LOGD(BOT_TAG, "data: type");
                                 int len = (tkns[k + 1].end - tkns[k + 1].start) + 1;
                                 char *data = malloc(len);
-                                snprintf(data, len, (char *)(data_ptr + tkns[k + 1].start));
+                                snprintf(data, len, "%s", (char *)(data_ptr + tkns[k + 1].start));
                                 if (strcmp(data, "0") != 0) {
                                     voided = true;
                                 }
@@ -396,27 +735,27 @@ static void BOT_payload_task(void *pvParameters) {
                                 k += jsmn_get_total_size(&tkns[k]);
                             }
                             break;
-                        case EVENT_GUILD_OBJ:
-                            if (json_equal(data_ptr, &tkns[k], "name")) {
-                                if (!json_null(data_ptr, &tkns[k + 1])) {
-                                    int len = (tkns[k + 1].end - tkns[k + 1].start) + 1;
-                                    char *name = malloc(len);
-                                    snprintf(name, len, (char *)(data_ptr + tkns[k + 1].start));
-                                    free(name);
-                                }
-                                k += jsmn_get_total_size(&tkns[k]);
-                            }
-                            break;
                         case EVENT_READY:
                             if (json_equal(data_ptr, &tkns[k], "session_id")) {
                                 if (!json_null(data_ptr, &tkns[k + 1])) {
                                     int len = (tkns[k + 1].end - tkns[k + 1].start) + 1;
                                     char *new_id = malloc(len);
-                                    snprintf(new_id, len, (char *)(data_ptr + tkns[k + 1].start));
+                                    snprintf(new_id, len, "%s", (char *)(data_ptr + tkns[k + 1].start));
                                     BOT_set_session_id(new_id);
                                     free(new_id);
                                 }
                                 k += jsmn_get_total_size(&tkns[k]);
+                            } else if (json_equal(data_ptr, &tkns[k], "user")) { // The bot itself, so it can be mentioned instead of the prefix
+                                int _k = k + 2;
+                                for (int l = 0; l < tkns[k + 1].size; l++) {
+                                    if (json_equal(data_ptr, &tkns[_k], "id")) {
+                                        BOT_set_user_id(data_ptr + tkns[_k + 1].start, tkns[_k + 1].end - tkns[_k + 1].start);
+                                    }
+                                    _k += jsmn_get_total_size(&tkns[_k]);
+                                }
+                                k += jsmn_get_total_size(&tkns[k]);
+                            } else {
+                                k += jsmn_get_total_size(&tkns[k]); // Skip keys we do not read
                             }
                             break;
                         default:
@@ -424,7 +763,7 @@ static void BOT_payload_task(void *pvParameters) {
                                 if (!json_null(data_ptr, &tkns[k + 1])) {
                                     int len = (tkns[k + 1].end - tkns[k + 1].start) + 1;
                                     char *beatStr = malloc(len);
-                                    snprintf(beatStr, len, (char *)(data_ptr + tkns[k + 1].start));
+                                    snprintf(beatStr, len, "%s", (char *)(data_ptr + tkns[k + 1].start));
                                     int beat = atoi(beatStr);
                                     BOT_set_heartbeat_int(beat);
                                     free(beatStr);
@@ -444,17 +783,26 @@ static void BOT_payload_task(void *pvParameters) {
                 if (voided || bot_message.content == NULL) {
                     ESP_LOGW(BOT_TAG, "Last message was voided or empty");
                     destroy_basic_message(&bot_message);
+                } else if (!BOT_authorize(&bot_message, data_ptr, member_roles) || !BOT_limit_allow(&bot_message)) {
+                    destroy_basic_message(&bot_message);
                 } else {
+                    trace_at(TRACE_WS_RECEIVE, bot_message.id, received_us);
+                    trace_at(TRACE_GATEWAY_TAKE, bot_message.id, taken_us);
                     ESP_LOGI(BOT_TAG, "Message: %s", bot_message.content);
-                    ESP_LOGI(BOT_TAG, "Author: %s", bot_message.author);
-                    ESP_LOGI(BOT_TAG, "Guild ID: %s", bot_message.guild_id);
-                    ESP_LOGI(BOT_TAG, "Channel ID: %s", bot_message.channel_id);
+                    BOT_intern_lock();
+                    ESP_LOGI(BOT_TAG, "Author: %s", BOT_intern_str(bot_message.author));
+                    BOT_intern_unlock();
+                    ESP_LOGI(BOT_TAG, "Guild ID: %llu", (unsigned long long)bot_message.guild_id);
+                    ESP_LOGI(BOT_TAG, "Channel ID: %llu", (unsigned long long)bot_message.channel_id);
 #ifdef CONFIG_BOT_BASIC_HELP
                     if (basic_help) {
-                        discord_send_text_message(BOT_BASIC_HELP, bot_message.channel_id);
+                        trace_set_current(bot_message.id);
+                        discord_reply_send(BOT_basic_help_reply, bot_message.channel_id);
+                        trace_set_current(0);
                         destroy_basic_message(&bot_message);
                     } else {
 #endif
+                        trace_point(TRACE_COMMAND_QUEUED, bot_message.id);
                         BOT_queue_command_message(&bot_message);
 #ifdef CONFIG_BOT_BASIC_HELP
                     }
@@ -473,14 +821,31 @@ extern esp_err_t BOT_init(BOT_payload_handler payload_handle, QueueHandle_t mess
     BOT_message_queue = message_queue_handle;
 
     ESP_LOGI(BOT_TAG, "Initalizing vars");
+    data_ptr = mem_place_alloc("gateway payload", BOT_ITEM_SIZE, MEM_BULK);
+    payload_ptr = mem_place_alloc("gateway send", BOT_BUFFER_SIZE, MEM_BULK);
+    if (data_ptr == NULL || payload_ptr == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
     BOT_session_id = strdup("null");
-    BOT_seq = strdup("null");
     xPayload_sema = xSemaphoreCreateBinary();
     xSemaphoreGive(xPayload_sema);
 
+    ESP_ERROR_CHECK(BOT_intern_init());
+    for (int i = 0; i < BOT_EVENT_COUNT; i++) {
+        BOT_event_handles[i] = BOT_intern(BOT_event_names[i].name, strlen(BOT_event_names[i].name));
+    }
+    ESP_ERROR_CHECK(BOT_cache_init());
+
     ESP_LOGI(BOT_TAG, "Initalizing discord rest api");
     ESP_ERROR_CHECK(discord_init(BOT_TOKEN));
 
+#ifdef CONFIG_BOT_BASIC_HELP
+    BOT_basic_help_reply = discord_reply_text(BOT_BASIC_HELP);
+    if (BOT_basic_help_reply == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+
     ESP_LOGI(BOT_TAG, "Initalizing BOT command manager");
     ESP_ERROR_CHECK(BOT_init_cmd());
 
@@ -0,0 +1,207 @@
+#include <limits.h>
+
+#include "bot_cmd.h"
+#include "helper.h"
+
+// A schema lists the arguments of a command seperated by spaces, it is shown in help as is
+// <name:type> is required, [name:type] is optional and <name...> takes the rest of the text
+// Types are text, int, id, user, role and channel, text if left out
+typedef struct BOT_param {
+    const char *name;
+    int name_len;
+    const char *type;
+    int type_len;
+    bool optional;
+    bool rest;
+} BOT_param_t;
+
+// Read the next parameter of a schema, returns where the one after it starts or NULL if there are no more
+static const char *BOT_next_param(const char *schema, BOT_param_t *param) {
+    while (*schema == ' ') {
+        schema++;
+    }
+    if (*schema != '<' && *schema != '[') {
+        return NULL;
+    }
+    param->optional = *schema++ == '[';
+    param->name = schema;
+    param->type = "text";
+    param->type_len = 4;
+    param->rest = false;
+    while (*schema != '\0' && *schema != ':' && *schema != '.' && *schema != '>' && *schema != ']') {
+        schema++;
+    }
+    param->name_len = schema - param->name;
+    if (*schema == ':') {
+        param->type = ++schema;
+        while (*schema != '\0' && *schema != '>' && *schema != ']') {
+            schema++;
+        }
+        param->type_len = schema - param->type;
+    } else if (*schema == '.') {
+        param->rest = true;
+        while (*schema == '.') {
+            schema++;
+        }
+    }
+    return *schema != '\0' ? schema + 1 : schema;
+}
+
+static inline bool BOT_param_is(const BOT_param_t *param, const char *type) {
+    return strlen(type) == (size_t)param->type_len && strncmp(param->type, type, param->type_len) == 0;
+}
+
+// Whether BOT_arg_fits knows the type of the parameter
+static bool BOT_param_known(const BOT_param_t *param) {
+    static const char *const types[] = {"text", "int", "id", "user", "role", "channel"};
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+        if (BOT_param_is(param, types[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Work out what an argument is from how it looks
+static void BOT_classify_arg(BOT_arg_t *arg) {
+    const char *s = arg->str;
+    size_t len = arg->len;
+    arg->type = BOT_ARG_TEXT;
+    if (len > 3 && s[0] == '<' && s[len - 1] == '>') {
+        BOT_arg_type_t type;
+        size_t skip = 2;
+        if (s[1] == '@' && (s[2] == '!' || s[2] == '&')) {
+            type = s[2] == '&' ? BOT_ARG_ROLE : BOT_ARG_USER;
+            skip = 3;
+        } else if (s[1] == '@') {
+            type = BOT_ARG_USER;
+        } else if (s[1] == '#') {
+            type = BOT_ARG_CHANNEL;
+        } else {
+            return;
+        }
+        if (string_to_u64(s + skip, len - skip - 1, &arg->id)) {
+            arg->type = type;
+        }
+        return;
+    }
+    bool negative = s[0] == '-';
+    uint64_t value;
+    if (!string_to_u64(s + negative, len - negative, &value)) {
+        return;
+    }
+    if (value <= LONG_MAX) {
+        arg->type = BOT_ARG_INT;
+        arg->integer = negative ? -(long)value : (long)value;
+    } else if (!negative) {
+        arg->type = BOT_ARG_SNOWFLAKE;
+        arg->id = value;
+    }
+}
+
+// Split text in place into at most max arguments in one pass, the last one takes whatever is left as is
+// Double quotes group words into one argument, \" and \\ escape inside them
+static int BOT_tokenize(char *text, BOT_arg_t *argv, int max) {
+    int argc = 0;
+    char *in = text;
+    while (argc < max) {
+        while (isspace((unsigned char)*in)) {
+            in++;
+        }
+        if (*in == '\0') {
+            break;
+        }
+        BOT_arg_t *arg = &argv[argc++];
+        arg->str = in;
+        if (argc == max) {
+            char *end = in + strlen(in);
+            while (isspace((unsigned char)end[-1])) {
+                end--;
+            }
+            *end = '\0';
+            arg->len = end - in;
+            BOT_classify_arg(arg);
+            break;
+        }
+        char *out = in; // never ahead of in, so the argument is rewritten over itself
+        bool quoted = *in == '"';
+        if (quoted) {
+            in++;
+        }
+        while (*in != '\0') {
+            if (quoted ? *in == '"' : isspace((unsigned char)*in)) {
+                in++;
+                break;
+            }
+            if (quoted && *in == '\\' && (in[1] == '"' || in[1] == '\\')) {
+                in++;
+            }
+            *out++ = *in++;
+        }
+        *out = '\0';
+        arg->len = out - arg->str;
+        BOT_classify_arg(arg);
+    }
+    return argc;
+}
+
+// Whether the argument can be read as the type the parameter wants, ids are accepted for mentions
+static bool BOT_arg_fits(const BOT_param_t *param, BOT_arg_t *arg) {
+    bool id = arg->type == BOT_ARG_SNOWFLAKE || (arg->type == BOT_ARG_INT && arg->integer >= 0);
+    if (BOT_param_is(param, "text")) {
+        return true;
+    } else if (BOT_param_is(param, "int")) {
+        return arg->type == BOT_ARG_INT;
+    } else if (BOT_param_is(param, "id")) {
+        if (arg->type == BOT_ARG_INT && id) {
+            arg->id = arg->integer;
+        }
+        return id;
+    }
+    BOT_arg_type_t mention;
+    if (BOT_param_is(param, "user")) {
+        mention = BOT_ARG_USER;
+    } else if (BOT_param_is(param, "role")) {
+        mention = BOT_ARG_ROLE;
+    } else if (BOT_param_is(param, "channel")) {
+        mention = BOT_ARG_CHANNEL;
+    } else {
+        return false; // BOT_init_cmd rejects schemas with any other type
+    }
+    if (arg->type == BOT_ARG_INT && id) {
+        arg->id = arg->integer;
+    }
+    return arg->type == mention || id;
+}
+
+// Tokenize content for a command and check it against the schema, error says why it does not match
+static bool BOT_parse_args(const char *schema, char *content, BOT_args_t *args, char *error, size_t error_len) {
+    BOT_param_t param;
+    int count = 0;
+    bool rest = false;
+    for (const char *next = schema; (next = BOT_next_param(next, &param)) != NULL;) {
+        count++;
+        rest = param.rest;
+    }
+    int max = rest ? count : count + 1; // one more than allowed, to notice extra arguments
+    args->argc = BOT_tokenize(content, args->argv, max < BOT_MAX_ARGS ? max : BOT_MAX_ARGS);
+
+    int i = 0;
+    for (const char *next = schema; (next = BOT_next_param(next, &param)) != NULL; i++) {
+        if (i >= args->argc) {
+            if (!param.optional) {
+                snprintf(error, error_len, "Missing %.*s", param.name_len, param.name);
+                return false;
+            }
+        } else if (!BOT_arg_fits(&param, &args->argv[i])) {
+            snprintf(error, error_len, "%.*s should be %s %.*s", param.name_len, param.name, param.type_len > 0 && strchr("aeiou", param.type[0]) ? "an" : "a",
+                     param.type_len, param.type);
+            return false;
+        }
+    }
+    if (args->argc > count) {
+        snprintf(error, error_len, "Too many arguments");
+        return false;
+    }
+    return true;
+}
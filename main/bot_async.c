@@ -0,0 +1,132 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "freertos/timers.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "bot_cmd.h"
+#include "discord.h"
+#include "trace.h"
+
+#define ASYNC_MAX_PENDING CONFIG_BOT_ASYNC_MAX_PENDING
+#define ASYNC_THINKING CONFIG_BOT_THINKING_TEXT
+#define ASYNC_TASK_SIZE 3072 // the one stack every continuation runs on
+
+static const char ASYNC_TAG[] = "BotAsync";
+
+// Resumed commands waiting for the executor, a command is never in it twice so it can not fill up
+static QueueHandle_t BOT_async_queue;
+static uint32_t BOT_pending_count;
+static discord_reply_t *BOT_thinking_reply;
+
+static void BOT_pending_free(BOT_pending_t *pending) {
+    if (pending->timer != NULL) {
+        xTimerDelete(pending->timer, portMAX_DELAY);
+    }
+    free(pending);
+    __atomic_sub_fetch(&BOT_pending_count, 1, __ATOMIC_RELAXED);
+}
+
+static void BOT_async_task(void *pvParameters) {
+    BOT_pending_t *pending;
+    for (;;) {
+        xQueueReceive(BOT_async_queue, &pending, portMAX_DELAY);
+        trace_set_current(pending->trace_id);
+        trace_point(TRACE_COMMAND_RUN, pending->trace_id);
+        bool done = pending->resume(pending);
+        trace_point(TRACE_COMMAND_DONE, pending->trace_id);
+        trace_set_current(0);
+        if (done) {
+            ESP_LOGD(ASYNC_TAG, "Deferred command done after %d ms", (int)((esp_timer_get_time() - pending->started_us) / 1000));
+            BOT_pending_free(pending);
+        }
+    }
+    vTaskDelete(NULL);
+}
+
+extern void BOT_resume(BOT_pending_t *pending, int status) {
+    pending->status = status;
+    xQueueSendToBack(BOT_async_queue, &pending, portMAX_DELAY);
+}
+
+extern BOT_pending_t *BOT_defer(const BOT_basic_message_t *msg, BOT_continuation resume, void *ctx) {
+    if (__atomic_add_fetch(&BOT_pending_count, 1, __ATOMIC_RELAXED) > ASYNC_MAX_PENDING) {
+        __atomic_sub_fetch(&BOT_pending_count, 1, __ATOMIC_RELAXED);
+        ESP_LOGW(ASYNC_TAG, "Too many deferred commands, rejecting one");
+        return NULL;
+    }
+    BOT_pending_t *pending = calloc(1, sizeof(BOT_pending_t));
+    if (pending == NULL) {
+        __atomic_sub_fetch(&BOT_pending_count, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    pending->resume = resume;
+    pending->ctx = ctx;
+    pending->started_us = esp_timer_get_time();
+    pending->channel_id = msg->channel_id;
+    pending->trace_id = msg->id;
+    return pending;
+}
+
+// Runs on the HTTP task, ids are 0 if the message was not created
+static void BOT_pending_sent(uint64_t channel_id, uint64_t message_id, void *ctx) {
+    BOT_pending_t *pending = ctx;
+    if (message_id != 0) {
+        pending->message_id = message_id;
+    }
+    BOT_resume(pending, message_id != 0 ? 0 : -1);
+}
+
+extern BOT_pending_t *BOT_think(const BOT_basic_message_t *msg, BOT_continuation resume, void *ctx) {
+    BOT_pending_t *pending = BOT_defer(msg, resume, ctx);
+    if (pending != NULL) {
+        discord_reply_send_cb(BOT_thinking_reply, pending->channel_id, BOT_pending_sent, pending); // resumes even if it fails
+    }
+    return pending;
+}
+
+extern esp_err_t BOT_pending_send(BOT_pending_t *pending, const char *content) {
+    return discord_send_message_cb(content, NULL, NULL, NULL, NULL, NULL, NULL, pending->channel_id, BOT_pending_sent, pending);
+}
+
+// Runs on the timer task
+static void BOT_pending_timer(TimerHandle_t timer) {
+    BOT_resume(pvTimerGetTimerID(timer), 0);
+}
+
+extern esp_err_t BOT_pending_sleep(BOT_pending_t *pending, uint32_t ms) {
+    TickType_t ticks = pdMS_TO_TICKS(ms) > 0 ? pdMS_TO_TICKS(ms) : 1;
+    if (pending->timer == NULL) {
+        pending->timer = xTimerCreate("BOT wait", ticks, pdFALSE, pending, BOT_pending_timer);
+        if (pending->timer == NULL || xTimerStart(pending->timer, portMAX_DELAY) != pdPASS) {
+            return ESP_FAIL;
+        }
+        return ESP_OK;
+    }
+    return xTimerChangePeriod(pending->timer, ticks, portMAX_DELAY) == pdPASS ? ESP_OK : ESP_FAIL; // also starts it
+}
+
+// Edits the placeholder if there is one, otherwise the reply is sent as a new message
+// Nothing follows the answer, so unlike other edits it may not be dropped or the placeholder would stay
+extern esp_err_t BOT_pending_reply(BOT_pending_t *pending, const char *content) {
+    if (pending->message_id != 0) {
+        return discord_edit_text_message(content, pending->channel_id, pending->message_id, DISCORD_PRIORITY_NORMAL);
+    }
+    return discord_send_text_message(content, pending->channel_id);
+}
+
+static esp_err_t BOT_async_init() {
+    BOT_async_queue = xQueueCreate(ASYNC_MAX_PENDING, sizeof(BOT_pending_t *));
+    BOT_thinking_reply = discord_reply_text(ASYNC_THINKING);
+    if (BOT_async_queue == NULL || BOT_thinking_reply == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreate(BOT_async_task, "BOT ASYNC", ASYNC_TASK_SIZE, NULL, 10, NULL) != pdPASS) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,395 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "esp_log.h"
+
+#include "bot_cache.h"
+#include "bot_intern.h"
+
+#define CACHE_GUILDS CONFIG_BOT_CACHE_GUILDS
+#define CACHE_CHANNELS CONFIG_BOT_CACHE_CHANNELS
+#define CACHE_ROLES CONFIG_BOT_CACHE_ROLES
+#define CACHE_CASTER_ROLE CONFIG_BOT_CASTER_ROLE
+#define CACHE_ADMINISTRATOR (1ULL << 3) // permission bit that allows everything
+
+_Static_assert(CACHE_GUILDS < 255, "Guild cache is too big");
+
+static const char CACHE_TAG[] = "BotCache";
+
+// Tables are kept as struct of arrays, a lookup only walks the ids and touches the rest once it has a match
+// Entries are unordered, a removed entry is replaced by the last one
+typedef struct BOT_guild_table {
+    uint64_t id[CACHE_GUILDS];
+    uint64_t owner_id[CACHE_GUILDS];
+    uint32_t last_used[CACHE_GUILDS];
+    BOT_str_t name[CACHE_GUILDS]; // each holds a reference
+    uint8_t count;
+} BOT_guild_table_t;
+
+typedef struct BOT_channel_table {
+    uint64_t id[CACHE_CHANNELS];
+    BOT_str_t name[CACHE_CHANNELS];
+    uint8_t guild[CACHE_CHANNELS]; // index into the guild table
+    uint8_t type[CACHE_CHANNELS];
+    uint16_t count;
+} BOT_channel_table_t;
+
+typedef struct BOT_role_table {
+    uint64_t id[CACHE_ROLES];
+    uint64_t permissions[CACHE_ROLES];
+    uint32_t color[CACHE_ROLES];
+    int16_t position[CACHE_ROLES];
+    BOT_str_t name[CACHE_ROLES];
+    uint8_t guild[CACHE_ROLES];
+    bool caster[CACHE_ROLES]; // named after the caster role or an administrator role
+    uint16_t count;
+} BOT_role_table_t;
+
+static BOT_guild_table_t BOT_guilds;
+static BOT_channel_table_t BOT_channels;
+static BOT_role_table_t BOT_roles;
+static uint32_t BOT_cache_clock;
+static SemaphoreHandle_t BOT_cache_lock;
+
+static BOT_str_t BOT_caster_name; // roles are told apart from it by handle
+
+// Names longer than a lookup can return are cut at a character boundary
+// The new name is interned before the old one is let go, so a name that did not change is not copied
+static void BOT_cache_rename(BOT_str_t *name, const char *str, size_t len) {
+    if (len >= BOT_CACHE_NAME_LENGTH) {
+        len = BOT_CACHE_NAME_LENGTH - 1;
+        while (len > 0 && ((unsigned char)str[len] & 0xC0) == 0x80) {
+            len--;
+        }
+    }
+    BOT_str_t old = *name;
+    *name = BOT_intern(str, len);
+    BOT_intern_release(old);
+}
+
+static int BOT_guild_index(uint64_t id) {
+    for (int i = 0; i < BOT_guilds.count; i++) {
+        if (BOT_guilds.id[i] == id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int BOT_channel_index(uint64_t id) {
+    for (int i = 0; i < BOT_channels.count; i++) {
+        if (BOT_channels.id[i] == id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int BOT_role_index(uint64_t id) {
+    for (int i = 0; i < BOT_roles.count; i++) {
+        if (BOT_roles.id[i] == id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void BOT_channel_remove_at(int i) {
+    BOT_intern_release(BOT_channels.name[i]);
+    int last = --BOT_channels.count;
+    BOT_channels.id[i] = BOT_channels.id[last];
+    BOT_channels.name[i] = BOT_channels.name[last];
+    BOT_channels.guild[i] = BOT_channels.guild[last];
+    BOT_channels.type[i] = BOT_channels.type[last];
+}
+
+static void BOT_role_remove_at(int i) {
+    BOT_intern_release(BOT_roles.name[i]);
+    int last = --BOT_roles.count;
+    BOT_roles.id[i] = BOT_roles.id[last];
+    BOT_roles.permissions[i] = BOT_roles.permissions[last];
+    BOT_roles.color[i] = BOT_roles.color[last];
+    BOT_roles.position[i] = BOT_roles.position[last];
+    BOT_roles.name[i] = BOT_roles.name[last];
+    BOT_roles.guild[i] = BOT_roles.guild[last];
+    BOT_roles.caster[i] = BOT_roles.caster[last];
+}
+
+// Drops a guild with its channels and roles, the last guild takes its index
+static void BOT_guild_remove_at(int index) {
+    for (int i = BOT_channels.count - 1; i >= 0; i--) {
+        if (BOT_channels.guild[i] == index) {
+            BOT_channel_remove_at(i);
+        }
+    }
+    for (int i = BOT_roles.count - 1; i >= 0; i--) {
+        if (BOT_roles.guild[i] == index) {
+            BOT_role_remove_at(i);
+        }
+    }
+    BOT_intern_release(BOT_guilds.name[index]);
+    int last = --BOT_guilds.count;
+    BOT_guilds.id[index] = BOT_guilds.id[last];
+    BOT_guilds.owner_id[index] = BOT_guilds.owner_id[last];
+    BOT_guilds.last_used[index] = BOT_guilds.last_used[last];
+    BOT_guilds.name[index] = BOT_guilds.name[last];
+    for (int i = 0; i < BOT_channels.count; i++) {
+        if (BOT_channels.guild[i] == last) {
+            BOT_channels.guild[i] = index;
+        }
+    }
+    for (int i = 0; i < BOT_roles.count; i++) {
+        if (BOT_roles.guild[i] == last) {
+            BOT_roles.guild[i] = index;
+        }
+    }
+}
+
+// Evict the least recently used guild other than keep, keep is moved along if it was the last one
+static bool BOT_cache_evict(int *keep) {
+    int victim = -1;
+    for (int i = 0; i < BOT_guilds.count; i++) {
+        if (i != *keep && (victim < 0 || BOT_guilds.last_used[i] < BOT_guilds.last_used[victim])) {
+            victim = i;
+        }
+    }
+    if (victim < 0) {
+        return false;
+    }
+    ESP_LOGI(CACHE_TAG, "Evicting guild %llu", (unsigned long long)BOT_guilds.id[victim]);
+    if (*keep == BOT_guilds.count - 1) {
+        *keep = victim;
+    }
+    BOT_guild_remove_at(victim);
+    return true;
+}
+
+extern void BOT_cache_put_guild(uint64_t id, const char *name, size_t len, uint64_t owner_id) {
+    xSemaphoreTake(BOT_cache_lock, portMAX_DELAY);
+    int index = BOT_guild_index(id);
+    if (index < 0) {
+        int none = -1;
+        if (BOT_guilds.count == CACHE_GUILDS) {
+            BOT_cache_evict(&none);
+        }
+        index = BOT_guilds.count++;
+        BOT_guilds.id[index] = id;
+        BOT_guilds.name[index] = 0;
+    }
+    BOT_guilds.owner_id[index] = owner_id;
+    BOT_guilds.last_used[index] = ++BOT_cache_clock;
+    BOT_cache_rename(&BOT_guilds.name[index], name, len);
+    xSemaphoreGive(BOT_cache_lock);
+}
+
+extern void BOT_cache_put_channel(uint64_t id, uint64_t guild_id, uint8_t type, const char *name, size_t len) {
+    xSemaphoreTake(BOT_cache_lock, portMAX_DELAY);
+    int guild = BOT_guild_index(guild_id);
+    int index = BOT_channel_index(id);
+    if (guild < 0) { // its guild was evicted or is not known yet
+        if (index >= 0) {
+            BOT_channel_remove_at(index);
+        }
+    } else {
+        if (index < 0) {
+            while (BOT_channels.count == CACHE_CHANNELS && BOT_cache_evict(&guild))
+                ;
+            if (BOT_channels.count < CACHE_CHANNELS) {
+                index = BOT_channels.count++;
+                BOT_channels.id[index] = id;
+                BOT_channels.name[index] = 0;
+            } else {
+                ESP_LOGW(CACHE_TAG, "No room for channel %llu", (unsigned long long)id);
+            }
+        }
+        if (index >= 0) {
+            BOT_channels.guild[index] = guild;
+            BOT_channels.type[index] = type;
+            BOT_cache_rename(&BOT_channels.name[index], name, len);
+        }
+    }
+    xSemaphoreGive(BOT_cache_lock);
+}
+
+extern void BOT_cache_put_role(uint64_t id, uint64_t guild_id, const char *name, size_t len, uint64_t permissions, uint32_t color,
+                               int16_t position) {
+    xSemaphoreTake(BOT_cache_lock, portMAX_DELAY);
+    int guild = BOT_guild_index(guild_id);
+    int index = BOT_role_index(id);
+    if (guild < 0) {
+        if (index >= 0) {
+            BOT_role_remove_at(index);
+        }
+    } else {
+        if (index < 0) {
+            while (BOT_roles.count == CACHE_ROLES && BOT_cache_evict(&guild))
+                ;
+            if (BOT_roles.count < CACHE_ROLES) {
+                index = BOT_roles.count++;
+                BOT_roles.id[index] = id;
+                BOT_roles.name[index] = 0;
+            } else {
+                ESP_LOGW(CACHE_TAG, "No room for role %llu", (unsigned long long)id);
+            }
+        }
+        if (index >= 0) {
+            BOT_roles.guild[index] = guild;
+            BOT_roles.permissions[index] = permissions;
+            BOT_roles.color[index] = color;
+            BOT_roles.position[index] = position;
+            BOT_cache_rename(&BOT_roles.name[index], name, len);
+            BOT_roles.caster[index] = (permissions & CACHE_ADMINISTRATOR) || (BOT_caster_name != 0 && BOT_roles.name[index] == BOT_caster_name);
+        }
+    }
+    xSemaphoreGive(BOT_cache_lock);
+}
+
+extern void BOT_cache_remove_guild(uint64_t id) {
+    xSemaphoreTake(BOT_cache_lock, portMAX_DELAY);
+    int index = BOT_guild_index(id);
+    if (index >= 0) {
+        BOT_guild_remove_at(index);
+    }
+    xSemaphoreGive(BOT_cache_lock);
+}
+
+extern void BOT_cache_remove_channel(uint64_t id) {
+    xSemaphoreTake(BOT_cache_lock, portMAX_DELAY);
+    int index = BOT_channel_index(id);
+    if (index >= 0) {
+        BOT_channel_remove_at(index);
+    }
+    xSemaphoreGive(BOT_cache_lock);
+}
+
+extern void BOT_cache_remove_role(uint64_t id) {
+    xSemaphoreTake(BOT_cache_lock, portMAX_DELAY);
+    int index = BOT_role_index(id);
+    if (index >= 0) {
+        BOT_role_remove_at(index);
+    }
+    xSemaphoreGive(BOT_cache_lock);
+}
+
+extern bool BOT_cache_get_guild(uint64_t id, BOT_cached_guild_t *out) {
+    xSemaphoreTake(BOT_cache_lock, portMAX_DELAY);
+    int index = BOT_guild_index(id);
+    if (index >= 0) {
+        out->id = id;
+        out->owner_id = BOT_guilds.owner_id[index];
+        out->channels = 0;
+        out->roles = 0;
+        for (int i = 0; i < BOT_channels.count; i++) {
+            out->channels += BOT_channels.guild[i] == index;
+        }
+        for (int i = 0; i < BOT_roles.count; i++) {
+            out->roles += BOT_roles.guild[i] == index;
+        }
+        BOT_intern_copy(BOT_guilds.name[index], out->name, sizeof(out->name));
+        BOT_guilds.last_used[index] = ++BOT_cache_clock;
+    }
+    xSemaphoreGive(BOT_cache_lock);
+    return index >= 0;
+}
+
+extern bool BOT_cache_get_channel(uint64_t id, BOT_cached_channel_t *out) {
+    xSemaphoreTake(BOT_cache_lock, portMAX_DELAY);
+    int index = BOT_channel_index(id);
+    if (index >= 0) {
+        int guild = BOT_channels.guild[index];
+        out->id = id;
+        out->guild_id = BOT_guilds.id[guild];
+        out->type = BOT_channels.type[index];
+        BOT_intern_copy(BOT_channels.name[index], out->name, sizeof(out->name));
+        BOT_guilds.last_used[guild] = ++BOT_cache_clock;
+    }
+    xSemaphoreGive(BOT_cache_lock);
+    return index >= 0;
+}
+
+static void BOT_cache_copy_role(int index, BOT_cached_role_t *out) {
+    int guild = BOT_roles.guild[index];
+    out->id = BOT_roles.id[index];
+    out->guild_id = BOT_guilds.id[guild];
+    out->permissions = BOT_roles.permissions[index];
+    out->color = BOT_roles.color[index];
+    out->position = BOT_roles.position[index];
+    BOT_intern_copy(BOT_roles.name[index], out->name, sizeof(out->name));
+    BOT_guilds.last_used[guild] = ++BOT_cache_clock;
+}
+
+extern bool BOT_cache_get_role(uint64_t id, BOT_cached_role_t *out) {
+    xSemaphoreTake(BOT_cache_lock, portMAX_DELAY);
+    int index = BOT_role_index(id);
+    if (index >= 0) {
+        BOT_cache_copy_role(index, out);
+    }
+    xSemaphoreGive(BOT_cache_lock);
+    return index >= 0;
+}
+
+// Role names are not unique, the highest role with the name is returned
+// A name that is not interned is not the name of any cached role, the cache holds on to the ones it uses
+extern bool BOT_cache_find_role(uint64_t guild_id, const char *name, BOT_cached_role_t *out) {
+    xSemaphoreTake(BOT_cache_lock, portMAX_DELAY);
+    int guild = BOT_guild_index(guild_id);
+    BOT_str_t wanted = BOT_intern_find(name, strlen(name));
+    if (wanted == 0 && name[0] != '\0') {
+        guild = -1;
+    }
+    int found = -1;
+    for (int i = 0; guild >= 0 && i < BOT_roles.count; i++) {
+        if (BOT_roles.guild[i] == guild && BOT_roles.name[i] == wanted &&
+            (found < 0 || BOT_roles.position[i] > BOT_roles.position[found])) {
+            found = i;
+        }
+    }
+    if (found >= 0) {
+        BOT_cache_copy_role(found, out);
+    }
+    xSemaphoreGive(BOT_cache_lock);
+    return found >= 0;
+}
+
+static bool BOT_role_set_has(const uint64_t *roles, int count, uint64_t id) {
+    int low = 0, high = count;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (roles[mid] < id) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low < count && roles[low] == id;
+}
+
+// Only the few caster roles of the guild are looked up in the member's roles, a guild that is not cached allows nothing
+extern bool BOT_cache_authorize(uint64_t guild_id, uint64_t user_id, const uint64_t *roles, int count) {
+    xSemaphoreTake(BOT_cache_lock, portMAX_DELAY);
+    int guild = BOT_guild_index(guild_id);
+    bool allowed = guild >= 0 && BOT_guilds.owner_id[guild] == user_id;
+    for (int i = 0; guild >= 0 && !allowed && i < BOT_roles.count; i++) {
+        if (BOT_roles.caster[i] && BOT_roles.guild[i] == guild) { // @everyone has the id of the guild and is never listed
+            allowed = BOT_roles.id[i] == guild_id || BOT_role_set_has(roles, count, BOT_roles.id[i]);
+        }
+    }
+    xSemaphoreGive(BOT_cache_lock);
+    return allowed;
+}
+
+extern esp_err_t BOT_cache_init() {
+    BOT_cache_lock = xSemaphoreCreateMutex();
+    if (BOT_cache_lock == NULL) {
+        ESP_LOGE(CACHE_TAG, "Failed to create lock");
+        return ESP_FAIL;
+    }
+    BOT_caster_name = BOT_intern(CACHE_CASTER_ROLE, strlen(CACHE_CASTER_ROLE));
+    ESP_LOGI(CACHE_TAG, "Caching %d guilds, %d channels and %d roles in %u bytes", CACHE_GUILDS, CACHE_CHANNELS, CACHE_ROLES,
+             (unsigned)(sizeof(BOT_guilds) + sizeof(BOT_channels) + sizeof(BOT_roles)));
+    return ESP_OK;
+}
@@ -0,0 +1,57 @@
+#ifndef __BOT_CACHE_H__
+#define __BOT_CACHE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "esp_err.h"
+
+#define BOT_CACHE_NAME_LENGTH 128 // longer names are cut at a character boundary
+
+// Copies of what is cached, the cache may change as soon as the lookup returns
+typedef struct BOT_cached_guild {
+    uint64_t id;
+    uint64_t owner_id;
+    uint16_t channels;
+    uint16_t roles;
+    char name[BOT_CACHE_NAME_LENGTH];
+} BOT_cached_guild_t;
+
+typedef struct BOT_cached_channel {
+    uint64_t id;
+    uint64_t guild_id;
+    uint8_t type; // discord channel type, 0 for text
+    char name[BOT_CACHE_NAME_LENGTH];
+} BOT_cached_channel_t;
+
+typedef struct BOT_cached_role {
+    uint64_t id;
+    uint64_t guild_id;
+    uint64_t permissions;
+    uint32_t color;
+    int16_t position;
+    char name[BOT_CACHE_NAME_LENGTH];
+} BOT_cached_role_t;
+
+extern esp_err_t BOT_cache_init();
+
+// Fed from gateway events by the BOT task
+extern void BOT_cache_put_guild(uint64_t id, const char *name, size_t len, uint64_t owner_id);
+extern void BOT_cache_put_channel(uint64_t id, uint64_t guild_id, uint8_t type, const char *name, size_t len);
+extern void BOT_cache_put_role(uint64_t id, uint64_t guild_id, const char *name, size_t len, uint64_t permissions, uint32_t color,
+                               int16_t position);
+extern void BOT_cache_remove_guild(uint64_t id);
+extern void BOT_cache_remove_channel(uint64_t id);
+extern void BOT_cache_remove_role(uint64_t id);
+
+// Safe from any task, false if it is not cached
+extern bool BOT_cache_get_guild(uint64_t id, BOT_cached_guild_t *out);
+extern bool BOT_cache_get_channel(uint64_t id, BOT_cached_channel_t *out);
+extern bool BOT_cache_get_role(uint64_t id, BOT_cached_role_t *out);
+extern bool BOT_cache_find_role(uint64_t guild_id, const char *name, BOT_cached_role_t *out);
+
+// Whether a member may run caster commands, roles is the sorted set of the member's role ids
+extern bool BOT_cache_authorize(uint64_t guild_id, uint64_t user_id, const uint64_t *roles, int count);
+
+#endif // __BOT_CACHE_H__
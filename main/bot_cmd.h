@@ -0,0 +1,130 @@
+#ifndef __BOT_CMD_H__
+#define __BOT_CMD_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/timers.h"
+#include "bot_intern.h"
+#include "helper.h"
+
+#define BOT_ID_LENGTH 24                      // snowflakes are at most 20 digits
+#define BOT_MENTION_LENGTH (BOT_ID_LENGTH + 3) // <@id>
+
+// Ids are kept as snowflakes, 0 if the message did not have one
+typedef struct BOT_basic_message {
+    uint64_t id;
+    uint64_t channel_id;
+    uint64_t guild_id;
+    uint64_t author_id;
+    BOT_str_t author; // holds a reference
+    char *content;
+    bool caster; // the author may run caster commands, worked out once while the message is parsed
+} BOT_basic_message_t;
+
+// Commands are grouped by how long they may take, each group has its own workers so a slow command never holds up a fast one
+typedef enum BOT_command_class {
+    BOT_CMD_INLINE, // cheap, run right on the command task
+    BOT_CMD_FAST,
+    BOT_CMD_SLOW, // may block on the network, eg. waiting for a response, unless it is deferred
+    BOT_CMD_CLASS_COUNT,
+} BOT_command_class_t;
+
+#define BOT_MAX_ARGS 8
+
+// What an argument looks like, checked against the type the command asks for
+typedef enum BOT_arg_type {
+    BOT_ARG_TEXT,
+    BOT_ARG_INT,       // digits that fit a long, possibly negative
+    BOT_ARG_SNOWFLAKE, // digits too long for an int, such as a bare id
+    BOT_ARG_USER,      // <@id> or <@!id>
+    BOT_ARG_ROLE,      // <@&id>
+    BOT_ARG_CHANNEL,   // <#id>
+} BOT_arg_type_t;
+
+// A view into the message content, which is split in place
+typedef struct BOT_arg {
+    const char *str; // terminated, quotes removed
+    uint16_t len;
+    BOT_arg_type_t type;
+    union {
+        long integer;
+        uint64_t id; // mentions and snowflakes
+    };
+} BOT_arg_t;
+
+typedef struct BOT_args {
+    int argc;
+    BOT_arg_t argv[BOT_MAX_ARGS];
+} BOT_args_t;
+
+#define BOT_ALIASES(...) ((const char *const[]){__VA_ARGS__, NULL})
+#define BOT_NO_ALIASES ((const char *const[]){NULL})
+
+// Runs on a worker of its class, args were already checked against the schema of the command
+typedef esp_err_t (*BOT_command_handler)(const BOT_basic_message_t *msg, const BOT_args_t *args);
+
+typedef struct BOT_command {
+    const char *name;
+    const char *const *aliases; // NULL terminated
+    BOT_command_handler handler;
+    BOT_command_class_t cls; // where the handler runs
+    const char *args;        // argument schema, also shown in help, see BOT_parse_args
+    const char *help;
+    bool caster; // only members with the caster role, administrators and the guild owner may run it
+} BOT_command_t;
+
+// How long commands wait for a worker and how long they run
+typedef struct BOT_command_stats {
+    uint32_t runs;
+    uint32_t rejected; // the job queue of its class was full
+    int64_t wait_total_us;
+    int64_t wait_max_us;
+    int64_t exec_total_us;
+    int64_t exec_max_us;
+} BOT_command_stats_t;
+
+extern void BOT_get_command_stats(const char *name, BOT_command_stats_t *stats); // all zero for an unknown command
+
+// Mentions are written when they are needed instead of being kept with the message
+static inline char *BOT_mention_user(char *out, uint64_t id) {
+    int len = 2 + string_from_u64(out + 2, id);
+    out[0] = '<';
+    out[1] = '@';
+    out[len++] = '>';
+    out[len] = '\0';
+    return out;
+}
+
+typedef struct BOT_pending BOT_pending_t;
+
+// One step of a deferred command, run on the async executor every time the command is resumed
+// Returns true once the command is done, otherwise it must have started something that resumes it
+typedef bool (*BOT_continuation)(BOT_pending_t *pending);
+
+// All a deferred command holds on to while it waits, instead of a task stack
+struct BOT_pending {
+    BOT_continuation resume;
+    void *ctx;    // belongs to the command, it has to free it before it is done
+    uint8_t step; // left to the continuation to keep track of where it is, 0 on the first resume
+    int status;   // result of what it waited on, -1 if that failed
+    int64_t started_us;
+    TimerHandle_t timer; // created by the first sleep
+    uint64_t channel_id;
+    uint64_t message_id; // last message the command posted, 0 if there is none
+    uint64_t trace_id;   // message that started the command, what it sends later is traced under it
+};
+
+// A handler defers by creating a pending command and starting whatever resumes it, then returns and frees its worker
+extern BOT_pending_t *BOT_defer(const BOT_basic_message_t *msg, BOT_continuation resume, void *ctx);
+// Defer and post a placeholder, the continuation is resumed once it exists and replies by editing it
+extern BOT_pending_t *BOT_think(const BOT_basic_message_t *msg, BOT_continuation resume, void *ctx);
+extern void BOT_resume(BOT_pending_t *pending, int status); // from any task, eg. once a sensor was read
+extern esp_err_t BOT_pending_send(BOT_pending_t *pending, const char *content); // resumed once the message exists
+extern esp_err_t BOT_pending_sleep(BOT_pending_t *pending, uint32_t ms);
+extern esp_err_t BOT_pending_reply(BOT_pending_t *pending, const char *content); // does not resume
+
+#endif // __BOT_CMD_H__
@@ -10,71 +10,350 @@
 #include "esp_event.h"
 #include "esp_log.h"
 #include "esp_system.h"
-// #include <unordered_map>
+#include "esp_timer.h"
+#include <ctype.h>
 
+#include "bot_args.c"
+#include "bot_async.c"
 #include "bot_commands.c"
+#include "bot_limit.c"
+#include "trace.h"
 
 #define COMMAND_QUEUE_SIZE CONFIG_WEBSOCKET_QUEUE_SIZE
-#define COMMAND_MAX_TASK 5     // max number of concurrent tasks
-#define COMMAND_TASK_SIZE 2048 // Amount of memory each command task has
+#define COMMAND_MAX_TASK 5          // max number of concurrent tasks
+#define COMMAND_TASK_SIZE 3072      // Amount of memory each fast command task has
+#define COMMAND_SLOW_TASK_SIZE 4096 // Amount of memory each slow command task has
+#define COMMAND_FAST_WORKERS 3
+#define COMMAND_SLOW_WORKERS 2 // at most this many slow commands run at once
+#define COMMAND_STACK_POOL (COMMAND_FAST_WORKERS * COMMAND_TASK_SIZE + COMMAND_SLOW_WORKERS * COMMAND_SLOW_TASK_SIZE)
+#define COMMAND_INDEX_SIZE 64 // slots for command names and aliases, a power of two kept at most half full
+
+_Static_assert(COMMAND_FAST_WORKERS + COMMAND_SLOW_WORKERS <= COMMAND_MAX_TASK, "Too many command workers");
 
 static QueueHandle_t BOT_command_queue;
 static TaskHandle_t handles[COMMAND_MAX_TASK];
+static StaticTask_t BOT_worker_tcbs[COMMAND_MAX_TASK];
+static StackType_t BOT_worker_stacks[COMMAND_STACK_POOL]; // sliced between the workers, stack depth is in bytes
+static SemaphoreHandle_t BOT_stats_lock;
 static const char CMD_TAG[] = "BotCMD";
 
-typedef struct BOT_basic_message {
-    char *channel_id;
-    char *guild_id;
-    char *author;
-    char *author_mention;
-    char *author_id;
-    char *content;
-} BOT_basic_message_t;
-
-#define msg_set_channel_id(msg, string) msg.channel_id = strdup(string);
-#define msg_set_guild_id(msg, string) msg.guild_id = strdup(string);
-#define msg_set_author(msg, string) msg.author = strdup(string);
-#define msg_set_author_mention(msg, string) msg.author_mention = strdup(string);
-#define msg_set_author_id(msg, string) msg.author_id = strdup(string);
-#define msg_set_content(msg, string) msg.content = strdup(string);
+typedef struct BOT_command_class_cfg {
+    const char *name;
+    uint8_t workers;
+    uint16_t stack;
+} BOT_command_class_cfg_t;
+
+static const BOT_command_class_cfg_t BOT_command_classes[BOT_CMD_CLASS_COUNT] = {
+    [BOT_CMD_INLINE] = {"inline", 0, 0},
+    [BOT_CMD_FAST] = {"fast", COMMAND_FAST_WORKERS, COMMAND_TASK_SIZE},
+    [BOT_CMD_SLOW] = {"slow", COMMAND_SLOW_WORKERS, COMMAND_SLOW_TASK_SIZE},
+};
+
+static QueueHandle_t BOT_job_queues[BOT_CMD_CLASS_COUNT];
+
+#define COMMAND_COUNT (sizeof(BOT_commands) / sizeof(BOT_commands[0]))
+
+static BOT_command_stats_t BOT_stats[COMMAND_COUNT];
+
+typedef struct BOT_command_job {
+    BOT_basic_message_t message;
+    const BOT_command_t *command;
+    BOT_args_t args; // views into message.content
+    int64_t queued_us;
+} BOT_command_job_t;
+
+// Command names and aliases are hashed into an open addressed table once, so finding a command does not depend on how many there are
+// Built at init rather than generated as a perfect hash, the table is at most half full so a probe rarely goes past the first slot
+typedef struct BOT_command_slot {
+    const char *name; // NULL if the slot is empty
+    uint8_t len;
+    uint8_t command; // index into BOT_commands
+} BOT_command_slot_t;
+
+static BOT_command_slot_t BOT_command_index[COMMAND_INDEX_SIZE];
+
+#define msg_set_content(msg, string)               \
+    do {                                           \
+        free((msg).content);                       \
+        (msg).content = strdup(string);            \
+    } while (0)
 
 static void destroy_basic_message(BOT_basic_message_t *msg) {
-    free(msg->channel_id);
-    free(msg->guild_id);
-    free(msg->author);
-    free(msg->author_id);
-    free(msg->author_mention);
+    BOT_intern_release(msg->author);
     free(msg->content);
 }
 
+static inline char BOT_command_fold(char c) {
+#ifdef CONFIG_BOT_CASE_SENSITIVE
+    return c;
+#else
+    return tolower((unsigned char)c);
+#endif
+}
+
+// FNV-1a of the case folded name
+static uint32_t BOT_command_hash(const char *name, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (uint8_t)BOT_command_fold(name[i])) * 16777619u;
+    }
+    return hash;
+}
+
+static bool BOT_command_equal(const char *a, const char *b, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (BOT_command_fold(a[i]) != BOT_command_fold(b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Slot holding the name, or the empty slot where it would go
+static BOT_command_slot_t *BOT_command_slot(const char *name, size_t len) {
+    uint32_t i = BOT_command_hash(name, len);
+    for (;;) {
+        BOT_command_slot_t *slot = &BOT_command_index[i & (COMMAND_INDEX_SIZE - 1)];
+        if (slot->name == NULL || (slot->len == len && BOT_command_equal(slot->name, name, len))) {
+            return slot;
+        }
+        i++;
+    }
+}
+
+static esp_err_t BOT_command_add_name(const char *name, uint8_t command, int *names) {
+    size_t len = strlen(name);
+    if (++*names > COMMAND_INDEX_SIZE / 2 || len > UINT8_MAX) {
+        ESP_LOGE(CMD_TAG, "No room to add command %s", name);
+        return ESP_ERR_NO_MEM;
+    }
+    BOT_command_slot_t *slot = BOT_command_slot(name, len);
+    if (slot->name != NULL) {
+        ESP_LOGE(CMD_TAG, "Command %s is already used by %s", name, BOT_commands[slot->command].name);
+        return ESP_ERR_INVALID_STATE;
+    }
+    slot->name = name;
+    slot->len = len;
+    slot->command = command;
+    return ESP_OK;
+}
+
+static esp_err_t BOT_index_commands() {
+    int names = 0;
+    for (uint8_t i = 0; i < COMMAND_COUNT; i++) {
+        esp_err_t err = BOT_command_add_name(BOT_commands[i].name, i, &names);
+        for (const char *const *alias = BOT_commands[i].aliases; err == ESP_OK && *alias != NULL; alias++) {
+            err = BOT_command_add_name(*alias, i, &names);
+        }
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    return ESP_OK;
+}
+
+// Every parameter type has to be one BOT_arg_fits knows, a typo would otherwise reject every argument
+static esp_err_t BOT_check_schemas() {
+    for (size_t i = 0; i < COMMAND_COUNT; i++) {
+        BOT_param_t param;
+        for (const char *next = BOT_commands[i].args; (next = BOT_next_param(next, &param)) != NULL;) {
+            if (!BOT_param_known(&param)) {
+                ESP_LOGE(CMD_TAG, "Argument %.*s of command %s has an unknown type %.*s", param.name_len, param.name, BOT_commands[i].name,
+                         param.type_len, param.type);
+                return ESP_ERR_INVALID_ARG;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+// Match the first word of the content, args is set to the rest of it without leading spaces
+static const BOT_command_t *BOT_find_command(const char *content, const char **args) {
+    while (isspace((unsigned char)*content)) {
+        content++;
+    }
+    const char *end = content;
+    while (*end != '\0' && !isspace((unsigned char)*end)) {
+        end++;
+    }
+    *args = end;
+    while (isspace((unsigned char)**args)) {
+        (*args)++;
+    }
+    if (end == content) {
+        return NULL;
+    }
+    BOT_command_slot_t *slot = BOT_command_slot(content, end - content);
+    return slot->name != NULL ? &BOT_commands[slot->command] : NULL;
+}
+
+#define COMMAND_HELP_LINE "%s%s%s: %s\n"
+#define COMMAND_HELP_ARGS(command) (command)->name, *(command)->args != '\0' ? " " : "", (command)->args, (command)->help
+
+// Help is made from the command table so it always lists what the bot actually answers to
+static esp_err_t BOT_build_help() {
+    static const char header[] = "Use any of the following after " CONFIG_BOT_PREFIX "\n```";
+    static const char footer[] = "```";
+    size_t len = strlen(header) + strlen(footer);
+    for (int i = 0; i < COMMAND_COUNT; i++) {
+        len += snprintf(NULL, 0, COMMAND_HELP_LINE, COMMAND_HELP_ARGS(&BOT_commands[i]));
+    }
+    char *text = malloc(len + 1);
+    if (text == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    char *out = stpcpy(text, header);
+    for (int i = 0; i < COMMAND_COUNT; i++) {
+        out += sprintf(out, COMMAND_HELP_LINE, COMMAND_HELP_ARGS(&BOT_commands[i]));
+    }
+    strcpy(out, footer);
+    BOT_help_reply = discord_reply_text(text); // only the rendered body is kept
+    free(text);
+    return BOT_help_reply != NULL ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+static void BOT_record_stats(const BOT_command_t *command, int64_t wait_us, int64_t exec_us) {
+    BOT_command_stats_t *stats = &BOT_stats[command - BOT_commands];
+    xSemaphoreTake(BOT_stats_lock, portMAX_DELAY);
+    stats->runs++;
+    stats->wait_total_us += wait_us;
+    stats->exec_total_us += exec_us;
+    if (wait_us > stats->wait_max_us) {
+        stats->wait_max_us = wait_us;
+    }
+    if (exec_us > stats->exec_max_us) {
+        stats->exec_max_us = exec_us;
+    }
+    xSemaphoreGive(BOT_stats_lock);
+}
+
+// Runs the handler and frees the message
+static void BOT_run_job(BOT_command_job_t *job) {
+    int64_t start = esp_timer_get_time();
+    trace_set_current(job->message.id); // what the handler sends is traced under its message
+    trace_point(TRACE_COMMAND_RUN, job->message.id);
+    if (job->command->handler(&job->message, &job->args) != ESP_OK) {
+        ESP_LOGW(CMD_TAG, "Command %s failed", job->command->name);
+    }
+    trace_point(TRACE_COMMAND_DONE, job->message.id);
+    trace_set_current(0);
+    int64_t end = esp_timer_get_time();
+    ESP_LOGD(CMD_TAG, "Command %s waited %d us, ran %d us", job->command->name, (int)(start - job->queued_us), (int)(end - start));
+    BOT_record_stats(job->command, start - job->queued_us, end - start);
+    destroy_basic_message(&job->message);
+}
+
+static void BOT_command_worker_task(void *pvParameters) {
+    QueueHandle_t jobs = pvParameters;
+    BOT_command_job_t job;
+
+    for (;;) {
+        xQueueReceive(jobs, &job, portMAX_DELAY);
+        BOT_run_job(&job);
+    }
+    vTaskDelete(NULL);
+}
+
+// Matches each message to its command, then runs it here or hands it to the workers of its class
+static void BOT_send_usage(const BOT_command_job_t *job, const char *error) {
+    char usage[160];
+    snprintf(usage, sizeof(usage), "%s, use: `" CONFIG_BOT_PREFIX " %s %s`", error, job->command->name, job->command->args);
+    discord_send_text_message(usage, job->message.channel_id);
+}
+
 static void BOT_command_queue_task(void *pvParameters) {
-    BOT_basic_message_t user_message;
+    BOT_command_job_t job;
+    const char *args;
+    char error[64];
 
     for (;;) {
         ESP_LOGI(CMD_TAG, "Waiting for queue");
-        xQueuePeek(BOT_command_queue, &user_message, portMAX_DELAY);
+        xQueueReceive(BOT_command_queue, &job.message, portMAX_DELAY); // Wait for new message in queue
+        trace_point(TRACE_COMMAND_TAKE, job.message.id);
         ESP_LOGI(CMD_TAG, "Distilling command");
-        xQueueReceive(BOT_command_queue, &user_message, portMAX_DELAY); // Wait for new message in queue
 
-        // std::unordered_map<string, int> map;
+        job.queued_us = esp_timer_get_time();
+        job.command = BOT_find_command(job.message.content, &args);
+        if (job.command == NULL) {
+            ESP_LOGW(CMD_TAG, "Unknown command: %s", job.message.content);
+            destroy_basic_message(&job.message);
+        } else if (!BOT_parse_args(job.command->args, (char *)args, &job.args, error, sizeof(error))) { // args is within the content we own
+            ESP_LOGW(CMD_TAG, "Rejected %s: %s", job.command->name, error);
+            BOT_send_usage(&job, error);
+            destroy_basic_message(&job.message);
+        } else if (job.command->cls == BOT_CMD_INLINE) {
+            BOT_run_job(&job);
+        } else if (xQueueSendToBack(BOT_job_queues[job.command->cls], &job, 0) != pdPASS) {
+            ESP_LOGW(CMD_TAG, "All %s workers are busy, dropping %s", BOT_command_classes[job.command->cls].name, job.command->name);
+            xSemaphoreTake(BOT_stats_lock, portMAX_DELAY);
+            BOT_stats[job.command - BOT_commands].rejected++;
+            xSemaphoreGive(BOT_stats_lock);
+            destroy_basic_message(&job.message);
+        }
+    }
+    vTaskDelete(NULL);
+}
 
-        // TODO: match and call handler right here
+// Workers are created once from static memory, each class gets its own job queue and stack size
+static esp_err_t BOT_start_workers() {
+    char name[configMAX_TASK_NAME_LEN];
+    int worker = 0;
+    size_t stack = 0;
+    for (int cls = 0; cls < BOT_CMD_CLASS_COUNT; cls++) {
+        const BOT_command_class_cfg_t *cfg = &BOT_command_classes[cls];
+        if (cfg->workers == 0) {
+            continue;
+        }
+        BOT_job_queues[cls] = xQueueCreate(COMMAND_QUEUE_SIZE, sizeof(BOT_command_job_t));
+        if (BOT_job_queues[cls] == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        for (int i = 0; i < cfg->workers; i++, worker++) {
+            snprintf(name, sizeof(name), "CMD %s %d", cfg->name, i);
+            handles[worker] = xTaskCreateStatic(BOT_command_worker_task, name, cfg->stack, BOT_job_queues[cls], 9,
+                                                BOT_worker_stacks + stack, &BOT_worker_tcbs[worker]);
+            if (handles[worker] == NULL) {
+                return ESP_FAIL;
+            }
+            stack += cfg->stack;
+        }
+    }
+    return ESP_OK;
+}
 
-        destroy_basic_message(BOT_command_queue);
+extern void BOT_get_command_stats(const char *name, BOT_command_stats_t *stats) {
+    const char *args;
+    const BOT_command_t *command = BOT_find_command(name, &args);
+    memset(stats, 0, sizeof(BOT_command_stats_t));
+    if (command != NULL) {
+        xSemaphoreTake(BOT_stats_lock, portMAX_DELAY);
+        *stats = BOT_stats[command - BOT_commands];
+        xSemaphoreGive(BOT_stats_lock);
     }
-    vTaskDelete(NULL);
 }
 
 extern void BOT_queue_command_message(BOT_basic_message_t *message) {
-    xQueueSendToBack(BOT_command_queue, message, 0);
+    if (xQueueSendToBack(BOT_command_queue, message, 0) == errQUEUE_FULL) {
+        ESP_LOGW(CMD_TAG, "Command queue is full, dropping %s", message->content);
+        destroy_basic_message(message);
+    }
 }
 
 extern esp_err_t BOT_init_cmd() {
+    if (BOT_check_schemas() != ESP_OK || BOT_index_commands() != ESP_OK || BOT_build_help() != ESP_OK || BOT_async_init() != ESP_OK) {
+        ESP_LOGE(CMD_TAG, "Failed to set up commands");
+        return ESP_FAIL;
+    }
     BOT_command_queue = xQueueCreate(COMMAND_QUEUE_SIZE, sizeof(struct BOT_basic_message));
-    if (BOT_command_queue == NULL) {
+    BOT_stats_lock = xSemaphoreCreateMutex();
+    if (BOT_command_queue == NULL || BOT_stats_lock == NULL) {
         ESP_LOGE(CMD_TAG, "Failed to create queue");
         return ESP_FAIL;
     }
+    if (BOT_start_workers() != ESP_OK) {
+        ESP_LOGE(CMD_TAG, "Failed to start command workers");
+        return ESP_FAIL;
+    }
     if (xTaskCreate(BOT_command_queue_task, "BOT CMD", 4096, NULL, 10, NULL) != pdPASS) {
         ESP_LOGE(CMD_TAG, "Failed to start command manager task");
         return ESP_FAIL;
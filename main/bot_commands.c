@@ -1,2 +1,94 @@
+#include "esp_timer.h"
+
+#include "bot_cmd.h"
 #include "discord.h"
-#include "helper.h"
\ No newline at end of file
+#include "helper.h"
+#include "trace.h"
+
+#define BOT_STATS_LINE_SIZE 64
+
+static discord_reply_t *BOT_help_reply; // generated from the command table on init
+
+static esp_err_t BOT_cmd_stats(const BOT_basic_message_t *msg, const BOT_args_t *args); // walks the command table below
+
+static esp_err_t BOT_cmd_echo(const BOT_basic_message_t *msg, const BOT_args_t *args) {
+    return discord_send_text_message(args->argv[0].str, msg->channel_id);
+}
+
+// Posted at low priority, through the webhook of the announcement channel when it has one
+static esp_err_t BOT_cmd_announce(const BOT_basic_message_t *msg, const BOT_args_t *args) {
+    uint64_t channel_id = discord_announce_channel();
+    return discord_send_announcement(args->argv[0].str, NULL, NULL, NULL, NULL, NULL, NULL, channel_id != 0 ? channel_id : msg->channel_id);
+}
+
+// Resumed once the placeholder exists, so the time is a full round trip through discord
+static bool BOT_ping_done(BOT_pending_t *pending) {
+    char reply[32];
+    snprintf(reply, sizeof(reply), "Pong! %d ms", (int)((esp_timer_get_time() - pending->started_us) / 1000));
+    BOT_pending_reply(pending, reply);
+    return true;
+}
+
+static esp_err_t BOT_cmd_ping(const BOT_basic_message_t *msg, const BOT_args_t *args) {
+    return BOT_think(msg, BOT_ping_done, NULL) != NULL ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+#ifdef CONFIG_TRACE_ENABLE
+// The records go to the console for host/trace.py, the channel only hears how many there were
+static esp_err_t BOT_cmd_trace(const BOT_basic_message_t *msg, const BOT_args_t *args) {
+    char reply[48];
+    snprintf(reply, sizeof(reply), "Dumped %d trace records", trace_dump());
+    return discord_send_text_message(reply, msg->channel_id);
+}
+#endif
+
+#ifdef CONFIG_BOT_HELP
+static esp_err_t BOT_cmd_help(const BOT_basic_message_t *msg, const BOT_args_t *args) {
+    return discord_reply_send(BOT_help_reply, msg->channel_id);
+}
+#endif
+
+// Every command the bot answers to, help lists them in this order
+static const BOT_command_t BOT_commands[] = {
+#ifdef CONFIG_BOT_HELP
+    {"help", BOT_ALIASES("commands"), BOT_cmd_help, BOT_CMD_INLINE, "", "Show this message", false},
+#endif
+    {"echo", BOT_ALIASES("say"), BOT_cmd_echo, BOT_CMD_FAST, "<text...>", "Echo a message", true},
+    {"announce", BOT_NO_ALIASES, BOT_cmd_announce, BOT_CMD_FAST, "<text...>", "Post an announcement", true},
+    {"ping", BOT_NO_ALIASES, BOT_cmd_ping, BOT_CMD_INLINE, "", "Test delay", false},
+    {"stats", BOT_NO_ALIASES, BOT_cmd_stats, BOT_CMD_FAST, "", "Show how long commands wait and run", true},
+#ifdef CONFIG_TRACE_ENABLE
+    {"trace", BOT_NO_ALIASES, BOT_cmd_trace, BOT_CMD_INLINE, "", "Dump latency traces to the console", true},
+#endif
+};
+
+// One line per command that was used, wait is how long it sat in the job queue of its class before a worker took it
+static esp_err_t BOT_cmd_stats(const BOT_basic_message_t *msg, const BOT_args_t *args) {
+    const size_t count = sizeof(BOT_commands) / sizeof(BOT_commands[0]);
+    const size_t size = (count + 4) * BOT_STATS_LINE_SIZE;
+    char *text = malloc(size);
+    if (text == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    size_t len = snprintf(text, size, "```\n%-10s %6s %6s %15s %15s\n", "command", "runs", "full", "wait avg/max us", "run avg/max us");
+    for (size_t i = 0; i < count && len < size; i++) {
+        BOT_command_stats_t stats;
+        BOT_get_command_stats(BOT_commands[i].name, &stats);
+        if (stats.runs == 0 && stats.rejected == 0) {
+            continue;
+        }
+        uint32_t runs = stats.runs > 0 ? stats.runs : 1;
+        len += snprintf(text + len, size - len, "%-10s %6u %6u %7lld/%-7lld %7lld/%lld\n", BOT_commands[i].name, (unsigned)stats.runs,
+                        (unsigned)stats.rejected, (long long)(stats.wait_total_us / runs), (long long)stats.wait_max_us,
+                        (long long)(stats.exec_total_us / runs), (long long)stats.exec_max_us);
+    }
+    discord_queue_stats_t queue;
+    discord_get_queue_stats(&queue);
+    if (len < size) {
+        snprintf(text + len, size - len, "\nHTTP queue: %u queued, %u rejected, %u dropped, %u at most\n```", (unsigned)queue.queued,
+                 (unsigned)queue.rejected, (unsigned)queue.dropped, (unsigned)queue.high_water);
+    }
+    esp_err_t err = discord_send_text_message(text, msg->channel_id);
+    free(text);
+    return err;
+}
@@ -0,0 +1,193 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "esp_log.h"
+
+#include "bot_intern.h"
+
+#define INTERN_POOL_SIZE CONFIG_BOT_INTERN_POOL
+#define INTERN_STRINGS CONFIG_BOT_INTERN_STRINGS
+#define INTERN_INDEX_SIZE (2 * INTERN_STRINGS) // every handle is in it at most once, so it is never more than half full
+#define INTERN_HEADER sizeof(BOT_str_t)        // each string in the pool starts with its handle
+
+_Static_assert(INTERN_POOL_SIZE <= UINT16_MAX && INTERN_STRINGS < UINT16_MAX, "String pool is too big");
+
+static const char INTERN_TAG[] = "BotIntern";
+
+typedef struct BOT_intern_entry {
+    uint32_t hash;
+    uint16_t offset; // where the text starts in the pool, 0 if the handle is free
+    uint16_t len;
+    uint16_t refs; // a string nobody references stays findable until the pool is compacted
+} BOT_intern_entry_t;
+
+static char BOT_intern_pool[INTERN_POOL_SIZE];
+static BOT_intern_entry_t BOT_intern_entries[INTERN_STRINGS + 1]; // by handle, 0 is the empty string
+static BOT_str_t BOT_intern_index[INTERN_INDEX_SIZE];            // open addressed handles, 0 if empty
+static uint16_t BOT_intern_pool_used;
+static uint16_t BOT_intern_count;    // handles in use, referenced or not
+static uint16_t BOT_intern_next = 1; // where looking for a free handle starts
+static SemaphoreHandle_t BOT_intern_mutex;
+
+static uint32_t BOT_intern_hash(const char *str, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (unsigned char)str[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Index slot holding the text, or the empty slot where it would go
+static BOT_str_t *BOT_intern_slot(const char *str, size_t len, uint32_t hash) {
+    for (size_t i = hash % INTERN_INDEX_SIZE;; i = (i + 1) % INTERN_INDEX_SIZE) {
+        BOT_str_t handle = BOT_intern_index[i];
+        if (handle == 0) {
+            return &BOT_intern_index[i];
+        }
+        const BOT_intern_entry_t *entry = &BOT_intern_entries[handle];
+        if (entry->hash == hash && entry->len == len && memcmp(BOT_intern_pool + entry->offset, str, len) == 0) {
+            return &BOT_intern_index[i];
+        }
+    }
+}
+
+// Slide the referenced strings to the front of the pool in place and free the handles of the rest
+// Handles that are kept do not change, only where their text is
+static void BOT_intern_compact() {
+    uint16_t before = BOT_intern_pool_used, write = 0;
+    memset(BOT_intern_index, 0, sizeof(BOT_intern_index));
+    for (uint16_t read = 0; read < before;) {
+        BOT_str_t handle;
+        memcpy(&handle, BOT_intern_pool + read, INTERN_HEADER);
+        BOT_intern_entry_t *entry = &BOT_intern_entries[handle];
+        uint16_t size = INTERN_HEADER + entry->len + 1;
+        if (entry->refs > 0) {
+            memmove(BOT_intern_pool + write, BOT_intern_pool + read, size);
+            entry->offset = write + INTERN_HEADER;
+            *BOT_intern_slot(BOT_intern_pool + entry->offset, entry->len, entry->hash) = handle;
+            write += size;
+        } else {
+            entry->offset = 0;
+            BOT_intern_count--;
+        }
+        read += size;
+    }
+    BOT_intern_pool_used = write;
+    ESP_LOGI(INTERN_TAG, "Compacted strings from %u to %u bytes, %u left", before, write, BOT_intern_count);
+}
+
+// Copy the text to the end of the pool under a free handle, 0 if there is no room
+static BOT_str_t BOT_intern_add(const char *str, size_t len, uint32_t hash) {
+    size_t size = INTERN_HEADER + len + 1;
+    if (BOT_intern_pool_used + size > INTERN_POOL_SIZE || BOT_intern_count == INTERN_STRINGS) {
+        return 0;
+    }
+    BOT_str_t handle = BOT_intern_next;
+    while (BOT_intern_entries[handle].offset != 0) {
+        handle = handle % INTERN_STRINGS + 1;
+    }
+    BOT_intern_next = handle % INTERN_STRINGS + 1;
+
+    char *record = BOT_intern_pool + BOT_intern_pool_used;
+    memcpy(record, &handle, INTERN_HEADER);
+    memcpy(record + INTERN_HEADER, str, len);
+    record[INTERN_HEADER + len] = '\0';
+
+    BOT_intern_entry_t *entry = &BOT_intern_entries[handle];
+    entry->hash = hash;
+    entry->offset = BOT_intern_pool_used + INTERN_HEADER;
+    entry->len = len;
+    entry->refs = 0;
+    BOT_intern_pool_used += size;
+    BOT_intern_count++;
+    return handle;
+}
+
+extern BOT_str_t BOT_intern(const char *str, size_t len) {
+    if (len == 0) {
+        return 0;
+    }
+    uint32_t hash = BOT_intern_hash(str, len);
+    xSemaphoreTake(BOT_intern_mutex, portMAX_DELAY);
+    BOT_str_t *slot = BOT_intern_slot(str, len, hash);
+    if (*slot == 0) {
+        BOT_str_t handle = BOT_intern_add(str, len, hash);
+        if (handle == 0) {
+            BOT_intern_compact();
+            slot = BOT_intern_slot(str, len, hash); // the index was rebuilt
+            handle = BOT_intern_add(str, len, hash);
+        }
+        *slot = handle;
+    }
+    BOT_str_t handle = *slot;
+    if (handle != 0) {
+        BOT_intern_entries[handle].refs++;
+    }
+    xSemaphoreGive(BOT_intern_mutex);
+    if (handle == 0) {
+        ESP_LOGW(INTERN_TAG, "No room for the string %.*s", (int)len, str);
+    }
+    return handle;
+}
+
+extern BOT_str_t BOT_intern_find(const char *str, size_t len) {
+    if (len == 0) {
+        return 0;
+    }
+    uint32_t hash = BOT_intern_hash(str, len);
+    xSemaphoreTake(BOT_intern_mutex, portMAX_DELAY);
+    BOT_str_t handle = *BOT_intern_slot(str, len, hash);
+    xSemaphoreGive(BOT_intern_mutex);
+    return handle;
+}
+
+extern BOT_str_t BOT_intern_retain(BOT_str_t str) {
+    if (str != 0) {
+        xSemaphoreTake(BOT_intern_mutex, portMAX_DELAY);
+        BOT_intern_entries[str].refs++;
+        xSemaphoreGive(BOT_intern_mutex);
+    }
+    return str;
+}
+
+extern void BOT_intern_release(BOT_str_t str) {
+    if (str != 0) {
+        xSemaphoreTake(BOT_intern_mutex, portMAX_DELAY);
+        BOT_intern_entries[str].refs--;
+        xSemaphoreGive(BOT_intern_mutex);
+    }
+}
+
+extern size_t BOT_intern_copy(BOT_str_t str, char *out, size_t size) {
+    xSemaphoreTake(BOT_intern_mutex, portMAX_DELAY);
+    size_t len = BOT_intern_entries[str].len < size - 1 ? BOT_intern_entries[str].len : size - 1;
+    memcpy(out, BOT_intern_str(str), len);
+    out[len] = '\0';
+    xSemaphoreGive(BOT_intern_mutex);
+    return len;
+}
+
+extern void BOT_intern_lock() {
+    xSemaphoreTake(BOT_intern_mutex, portMAX_DELAY);
+}
+
+extern void BOT_intern_unlock() {
+    xSemaphoreGive(BOT_intern_mutex);
+}
+
+extern const char *BOT_intern_str(BOT_str_t str) {
+    return str != 0 ? BOT_intern_pool + BOT_intern_entries[str].offset : "";
+}
+
+extern esp_err_t BOT_intern_init() {
+    BOT_intern_mutex = xSemaphoreCreateMutex();
+    if (BOT_intern_mutex == NULL) {
+        ESP_LOGE(INTERN_TAG, "Failed to create lock");
+        return ESP_FAIL;
+    }
+    ESP_LOGI(INTERN_TAG, "Interning up to %d strings in %u bytes", INTERN_STRINGS,
+             (unsigned)(sizeof(BOT_intern_pool) + sizeof(BOT_intern_entries) + sizeof(BOT_intern_index)));
+    return ESP_OK;
+}
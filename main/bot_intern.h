@@ -0,0 +1,32 @@
+#ifndef __BOT_INTERN_H__
+#define __BOT_INTERN_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+// Handle to an interned string, 0 is the empty string and needs no reference
+typedef uint16_t BOT_str_t;
+
+extern esp_err_t BOT_intern_init();
+
+// Takes a reference, text that is already interned gets its handle back without copying
+// Returns 0 if there is no room even after compacting
+extern BOT_str_t BOT_intern(const char *str, size_t len);
+// Handle of the text if it is interned, no reference is taken and nothing is added
+extern BOT_str_t BOT_intern_find(const char *str, size_t len);
+extern BOT_str_t BOT_intern_retain(BOT_str_t str);
+extern void BOT_intern_release(BOT_str_t str);
+
+// Copies the text into out, cut to fit, returns its length
+extern size_t BOT_intern_copy(BOT_str_t str, char *out, size_t size);
+
+// Compacting moves the text, so it is only read directly while the pool is locked
+// Nothing may be interned or released by the task holding the lock
+extern void BOT_intern_lock();
+extern void BOT_intern_unlock();
+extern const char *BOT_intern_str(BOT_str_t str);
+
+#endif // __BOT_INTERN_H__
@@ -0,0 +1,128 @@
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "bot_cmd.h"
+#include "discord.h"
+#include "helper.h"
+
+#define LIMIT_SLOTS CONFIG_BOT_LIMIT_SLOTS // a power of two
+#define LIMIT_PROBE 8                      // slots looked at for a key, the oldest of them is evicted when all are taken
+#define LIMIT_USER_INTERVAL_MS CONFIG_BOT_LIMIT_USER_INTERVAL_MS
+#define LIMIT_USER_BURST CONFIG_BOT_LIMIT_USER_BURST
+#define LIMIT_CHANNEL_INTERVAL_MS CONFIG_BOT_LIMIT_CHANNEL_INTERVAL_MS
+#define LIMIT_CHANNEL_BURST CONFIG_BOT_LIMIT_CHANNEL_BURST
+
+_Static_assert((LIMIT_SLOTS & (LIMIT_SLOTS - 1)) == 0 && LIMIT_SLOTS >= LIMIT_PROBE, "Rate limit slots must be a power of two");
+
+static const char LIMIT_TAG[] = "BotLimit";
+
+typedef enum BOT_limit_kind {
+    BOT_LIMIT_USER,
+    BOT_LIMIT_CHANNEL,
+} BOT_limit_kind_t;
+
+// GCRA state, a key may send again once now reaches its theoretical arrival time minus the burst allowance
+typedef struct BOT_limit_entry {
+    uint64_t key; // snowflake, 0 if the slot was never used
+    int64_t tat_ms;
+    uint32_t last_used;
+    uint8_t kind;
+    bool notified; // a cooldown notice for this key was sent since its last allowed command
+} BOT_limit_entry_t;
+
+static BOT_limit_entry_t BOT_limits[LIMIT_SLOTS];
+static uint32_t BOT_limit_clock;
+static uint32_t BOT_limit_dropped;
+
+// Only the BOT task uses the table, so it needs no lock
+// Entries already used by the current check are never evicted, the clock moves once per check
+static BOT_limit_entry_t *BOT_limit_entry(uint64_t key, BOT_limit_kind_t kind, int64_t now) {
+    uint32_t hash = (uint32_t)(key ^ (key >> 32)) * 2654435761u + kind;
+    BOT_limit_entry_t *victim = NULL;
+    for (int i = 0; i < LIMIT_PROBE; i++) {
+        BOT_limit_entry_t *entry = &BOT_limits[(hash + i) & (LIMIT_SLOTS - 1)];
+        if (entry->key == key && entry->kind == kind) {
+            entry->last_used = BOT_limit_clock;
+            return entry;
+        }
+        if (entry->key == 0) { // keys are never removed, so the key is not further along
+            victim = entry;
+            break;
+        }
+        if (entry->last_used == BOT_limit_clock) {
+            continue;
+        }
+        if (entry->tat_ms <= now) { // fully recovered, it holds nothing a fresh entry would not
+            if (victim == NULL || victim->tat_ms > now) {
+                victim = entry;
+            }
+        } else if (victim == NULL || (victim->tat_ms > now && entry->last_used < victim->last_used)) {
+            victim = entry;
+        }
+    }
+    victim->key = key;
+    victim->kind = kind;
+    victim->tat_ms = now;
+    victim->notified = false;
+    victim->last_used = BOT_limit_clock;
+    return victim;
+}
+
+// How long until the entry may send again, 0 if it may send now and the send was counted
+static int64_t BOT_limit_take(BOT_limit_entry_t *entry, int64_t now, int64_t interval, int burst) {
+    int64_t tat = entry->tat_ms > now ? entry->tat_ms : now;
+    int64_t allowed_at = tat - interval * (burst - 1);
+    if (now < allowed_at) {
+        return allowed_at - now;
+    }
+    entry->tat_ms = tat + interval;
+    return 0;
+}
+
+// Whether a command may be queued, rejected commands cost nothing past this point
+static bool BOT_limit_allow(const BOT_basic_message_t *msg) {
+    uint64_t user_id = msg->author_id, channel_id = msg->channel_id;
+    if (user_id == 0 || channel_id == 0) {
+        return true; // nothing to key it on
+    }
+    int64_t now = esp_timer_get_time() / 1000;
+    BOT_limit_clock++;
+    BOT_limit_entry_t *user = BOT_limit_entry(user_id, BOT_LIMIT_USER, now);
+    BOT_limit_entry_t *channel = BOT_limit_entry(channel_id, BOT_LIMIT_CHANNEL, now);
+
+    // Check both before taking from either, so a user that is limited does not use up the channel
+    BOT_limit_entry_t user_copy = *user, channel_copy = *channel;
+    BOT_limit_entry_t *limited = user;
+    int64_t wait = BOT_limit_take(&user_copy, now, LIMIT_USER_INTERVAL_MS, LIMIT_USER_BURST);
+    if (wait == 0) {
+        limited = channel;
+        wait = BOT_limit_take(&channel_copy, now, LIMIT_CHANNEL_INTERVAL_MS, LIMIT_CHANNEL_BURST);
+    }
+    if (wait == 0) {
+        user->tat_ms = user_copy.tat_ms;
+        channel->tat_ms = channel_copy.tat_ms;
+        user->notified = false;
+        channel->notified = false;
+        return true;
+    }
+
+    BOT_limit_dropped++;
+    ESP_LOGW(LIMIT_TAG, "Dropping command from %llu in %llu for %d ms, %s limit (%u dropped so far)", (unsigned long long)user_id,
+             (unsigned long long)channel_id, (int)wait, limited == user ? "user" : "channel", BOT_limit_dropped);
+#ifdef CONFIG_BOT_LIMIT_NOTICE
+    // One notice per limited key, a busy channel gets one however many users keep sending to it
+    if (!limited->notified) {
+        char mention[BOT_MENTION_LENGTH];
+        char notice[96];
+        int seconds = (int)((wait + 999) / 1000);
+        if (limited == user) {
+            snprintf(notice, sizeof(notice), "%s slow down, try again in %d s", BOT_mention_user(mention, user_id), seconds);
+        } else {
+            snprintf(notice, sizeof(notice), "Too many commands in this channel, try again in %d s", seconds);
+        }
+        discord_send_text_message(notice, msg->channel_id);
+        limited->notified = true;
+    }
+#endif
+    return false;
+}
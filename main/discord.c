@@ -1,90 +1,383 @@
 #include "discord.h"
+#include "helper.h"
 #include "http_post.c"
 #include "jsonBuilder.c"
 
 #define REST_PATH CONFIG_REST_PATH_PATTERN
+#define REST_MESSAGE_PATH CONFIG_REST_MESSAGE_PATH_PATTERN
+#define REST_WEBHOOK_PATH CONFIG_REST_WEBHOOK_PATH_PATTERN
+#define REST_MAX_WEBHOOKS CONFIG_REST_MAX_WEBHOOKS
+#define REST_ANNOUNCE_CHANNEL CONFIG_REST_ANNOUNCE_CHANNEL_ID
+#define REST_ANNOUNCE_WEBHOOK CONFIG_REST_ANNOUNCE_WEBHOOK_URL
+#define REST_WEBHOOK_URL_PATH "/webhooks/"
+#ifdef CONFIG_REST_WEBHOOK_WAIT
+#define REST_WEBHOOK_QUERY "?wait=true"
+#else
+#define REST_WEBHOOK_QUERY "?wait=false" // discord answers with no content
+#endif
 #define REST_AUTH_PREFIX CONFIG_REST_AUTH_PREFIX
 #define REST_COLOR CONFIG_BOT_COLOR
+#define REST_MESSAGE_ARENA CONFIG_REST_MESSAGE_ARENA_SIZE
+#define REST_ARENA_ALIGN sizeof(void *)
 
 static const char DISC_TAG[] = "Discord";
 
-static void discord_rest_post(const char *json_content, const char *channel_id) {
-    ESP_LOGI(DISC_TAG, "POSTing Message");
-    int length = strlen(REST_PATH) + strlen(channel_id) + 1;
-    char *path_buf = calloc(1, length);
-    snprintf(path_buf, length, REST_PATH, channel_id);
+typedef struct discord_field {
+    const char *name;
+    const char *value;
+    bool inline_field;
+    struct discord_field *next;
+} discord_field_t;
 
-    // strdup memory, as copied struct points to same elements
-    http_post_data_t postData = {
-        .jsonContent = strdup(json_content),
-        .path = strdup(path_buf),
+struct discord_embed {
+    discord_message_t *message; // the arena this embed allocates from
+    const char *title;
+    const char *description;
+    const char *url;
+    const char *timestamp; // ISO 8601
+    const char *thumbnail_url;
+    const char *image_url;
+    const char *author;
+    const char *author_icon_url;
+    const char *footer;
+    const char *footer_icon_url;
+    long color;
+    discord_field_t *fields;
+    discord_field_t *last_field;
+    struct discord_embed *next;
+};
+
+// Everything a message holds is bump allocated from the arena behind it, so it is freed at once after it is sent
+// The message itself is the descriptor the HTTP task serializes
+struct discord_message {
+    size_t size;
+    size_t used;
+    bool failed; // the arena ran out, the message is not sent
+    bool embed_list;
+    bool mentions_set;
+    uint8_t mentions; // discord_mention_t flags
+    uint8_t embed_count;
+    const char *content;
+    discord_embed_t *embeds;
+    discord_embed_t *last_embed;
+    char arena[];
+};
+
+typedef struct discord_sent_ctx {
+    discord_message_handler handler;
+    void *ctx;
+} discord_sent_ctx_t;
+
+// Channels that send announcements through a webhook instead of the bot token
+typedef struct discord_webhook {
+    uint64_t channel_id;
+    uint64_t webhook_id;
+    char path[HTTP_MAX_PATH]; // formatted once, it holds the webhook token so each request gets a copy
+} discord_webhook_t;
+
+static discord_webhook_t DISC_webhooks[REST_MAX_WEBHOOKS];
+static int DISC_webhook_count;
+static SemaphoreHandle_t DISC_webhook_lock; // a webhook may be replaced while announcements are sent
+static uint64_t DISC_announce_channel;       // 0 when none is configured
+
+static inline http_priority_t discord_http_priority(discord_priority_t priority) {
+    return priority == DISCORD_PRIORITY_LOW ? HTTP_PRIORITY_LOW : HTTP_PRIORITY_NORMAL;
+}
+
+// Fill in the route parameters of a request and queue it, message_id is 0 for routes without one
+static esp_err_t discord_rest_queue(http_request_t *request, uint64_t channel_id, uint64_t message_id) {
+    ESP_LOGI(DISC_TAG, "Queueing %s request", http_method_name(request->method));
+    request->major = channel_id;
+    request->minor = message_id;
+    return http_queue_message(request);
+}
+
+static esp_err_t discord_rest_request(esp_http_client_method_t method, http_priority_t priority, const char *route, uint64_t channel_id,
+                                      uint64_t message_id, char *json_content, http_body_serializer serialize,
+                                      http_response_handler on_complete, void *ctx) {
+    http_request_t request = {
+        .method = method,
+        .priority = priority,
+        .route = route,
+        .body = json_content, // already heap allocated, the HTTP task frees it
+        .serialize = serialize,
+        .on_complete = on_complete,
+        .ctx = ctx,
     };
+    return discord_rest_queue(&request, channel_id, message_id);
+}
 
-    free(path_buf);
+// Find a string value of a key that is in the top level object of a json response
+static bool discord_json_top_level_string(const char *json, int len, const char *key, char *out, int out_len) {
+    int depth = 0;
+    int key_len = strlen(key);
+    for (int i = 0; i < len; i++) {
+        char c = json[i];
+        if (c == '{' || c == '[') {
+            depth++;
+        } else if (c == '}' || c == ']') {
+            depth--;
+        } else if (c == '"') {
+            int start = ++i;
+            while (i < len && json[i] != '"') {
+                if (json[i] == '\\')
+                    i++;
+                i++;
+            }
+            if (depth != 1 || i - start != key_len || strncmp(json + start, key, key_len) != 0)
+                continue;
+            int j = i + 1;
+            while (j < len && json[j] == ' ')
+                j++;
+            if (j >= len || json[j] != ':') // matched a value, not a key
+                continue;
+            while (++j < len && json[j] == ' ')
+                ;
+            if (j >= len || json[j] != '"')
+                return false;
+            i = start = j + 1;
+            while (i < len && json[i] != '"')
+                i++;
+            if (i >= len || i - start >= out_len)
+                return false;
+            memcpy(out, json + start, i - start);
+            out[i - start] = '\0';
+            return true;
+        }
+    }
+    return false;
+}
 
-    http_queue_message(&postData);
+// Pull the new message id out of the message object that discord responds with
+static void discord_message_sent(int status, const char *response, int len, void *ctx) {
+    discord_sent_ctx_t *sent = ctx;
+    char channel[HTTP_ID_LENGTH];
+    char message[HTTP_ID_LENGTH];
+    uint64_t channel_id, message_id;
+    if (status / 100 == 2 && discord_json_top_level_string(response, len, "id", message, HTTP_ID_LENGTH) &&
+        discord_json_top_level_string(response, len, "channel_id", channel, HTTP_ID_LENGTH) &&
+        string_to_u64(message, strlen(message), &message_id) && string_to_u64(channel, strlen(channel), &channel_id)) {
+        sent->handler(channel_id, message_id, sent->ctx);
+    } else {
+        ESP_LOGW(DISC_TAG, "Message was not created, status %d", status); // status -1 if it was never sent
+        sent->handler(0, 0, sent->ctx);
+    }
+    free(sent);
 }
 
-// Currently only json content can be dynamiclly created
-static char *discord_json_build_content(const char *content, const char *title, const char *description, const char *author,
-                                        const char *author_icon_url, const char *footer, const char *footer_icon_url) {
+// Wrap on_sent so it gets the ids of the new message, if that fails on_sent is called with 0 ids right away
+static esp_err_t discord_sent_ctx_new(discord_message_handler on_sent, void *ctx, discord_sent_ctx_t **sent) {
+    *sent = NULL;
+    if (on_sent == NULL) {
+        return ESP_OK;
+    }
+    *sent = malloc(sizeof(discord_sent_ctx_t));
+    if (*sent == NULL) {
+        ESP_LOGE(DISC_TAG, "Could not allocate a sent message context");
+        on_sent(0, 0, ctx);
+        return ESP_ERR_NO_MEM;
+    }
+    (*sent)->handler = on_sent;
+    (*sent)->ctx = ctx;
+    return ESP_OK;
+}
 
-    ESP_LOGI(DISC_TAG, "Building content JSON");
+// Text replies are small enough to render from a template, embeds are streamed from a descriptor
+static const json_segment_t DISC_TEXT_TPL[] = {
+    JSON_LITERAL("{\"content\":"),
+    JSON_SLOT(JSON_SLOT_STRING, 0),
+    JSON_LITERAL("}"),
+};
+static void *discord_arena_alloc(discord_message_t *msg, size_t size, size_t align) {
+    size_t start = (msg->used + align - 1) & ~(align - 1);
+    if (msg->failed || start + size > msg->size) {
+        msg->failed = true;
+        return NULL;
+    }
+    msg->used = start + size;
+    return msg->arena + start;
+}
 
-    json_object_t f_json = json_init();
+// NULL stays NULL, a failed copy marks the message failed
+static const char *discord_arena_strdup(discord_message_t *msg, const char *value) {
+    if (value == NULL) {
+        return NULL;
+    }
+    size_t len = strlen(value) + 1;
+    char *copy = discord_arena_alloc(msg, len, 1);
+    return copy != NULL ? memcpy(copy, value, len) : NULL;
+}
 
-    if (content != NULL) {
-        json_key(&f_json, "content");
-        json_string(&f_json, content);
+static void discord_json_string_field(json_object_t *f_json, const char *key, const char *value) {
+    if (value != NULL) {
+        json_key(f_json, key);
+        json_string(f_json, value);
     }
+}
 
-    if (title != NULL || description != NULL || author != NULL || footer != NULL) {
-        json_key(&f_json, "embed");
-        json_open_list(&f_json);
+// Objects such as the author and footer that are left out when their main string is not set
+static void discord_json_named_object(json_object_t *f_json, const char *key, const char *name_key, const char *name,
+                                      const char *icon_url) {
+    if (name != NULL) {
+        json_key(f_json, key);
+        json_open_list(f_json);
+        discord_json_string_field(f_json, name_key, name);
+        discord_json_string_field(f_json, "icon_url", icon_url);
+        json_close_list(f_json);
+    }
+}
 
-        if (title != NULL) {
-            json_key(&f_json, "title");
-            json_string(&f_json, title);
-        }
+static void discord_json_write_embed(json_object_t *f_json, const discord_embed_t *embed) {
+    json_open_list(f_json);
+    discord_json_string_field(f_json, "title", embed->title);
+    discord_json_string_field(f_json, "description", embed->description);
+    discord_json_string_field(f_json, "url", embed->url);
+    discord_json_string_field(f_json, "timestamp", embed->timestamp);
+    discord_json_named_object(f_json, "thumbnail", "url", embed->thumbnail_url, NULL);
+    discord_json_named_object(f_json, "image", "url", embed->image_url, NULL);
+    discord_json_named_object(f_json, "author", "name", embed->author, embed->author_icon_url);
+    discord_json_named_object(f_json, "footer", "text", embed->footer, embed->footer_icon_url);
 
-        if (description != NULL) {
-            json_key(&f_json, "description");
-            json_string(&f_json, description);
+    if (embed->fields != NULL) {
+        json_key(f_json, "fields");
+        json_open_array(f_json);
+        for (const discord_field_t *field = embed->fields; field != NULL; field = field->next) {
+            json_open_list(f_json);
+            discord_json_string_field(f_json, "name", field->name);
+            discord_json_string_field(f_json, "value", field->value);
+            if (field->inline_field) {
+                json_key(f_json, "inline");
+                json_value(f_json, "true");
+            }
+            json_close_list(f_json);
         }
+        json_close_array(f_json);
+    }
 
-        if (author != NULL) {
-            json_key(&f_json, "author");
-            json_open_list(&f_json);
-            json_key(&f_json, "name");
-            json_string(&f_json, author);
-            if (author_icon_url != NULL) {
-                json_key(&f_json, "icon_url");
-                json_string(&f_json, author_icon_url);
-            }
-            json_close_list(&f_json);
+    json_key(f_json, "color");
+    json_int(f_json, embed->color);
+    json_close_list(f_json);
+}
+
+// Webhooks only accept a list of embeds, the same goes for sending more than one
+static void discord_json_write_content(json_object_t *f_json, const discord_message_t *msg) {
+    discord_json_string_field(f_json, "content", msg->content);
+
+    if (msg->embeds != NULL) {
+        bool list = msg->embed_list || msg->embed_count > 1;
+        if (list) {
+            json_key(f_json, "embeds");
+            json_open_array(f_json);
+        } else {
+            json_key(f_json, "embed");
+        }
+        for (const discord_embed_t *embed = msg->embeds; embed != NULL; embed = embed->next) {
+            discord_json_write_embed(f_json, embed);
+        }
+        if (list) {
+            json_close_array(f_json);
         }
+    }
 
-        if (footer != NULL) {
-            json_key(&f_json, "footer");
-            json_open_list(&f_json);
-            json_key(&f_json, "text");
-            json_string(&f_json, footer);
-            if (footer_icon_url != NULL) {
-                json_key(&f_json, "icon_url");
-                json_string(&f_json, footer_icon_url);
-            }
-            json_close_list(&f_json);
+    if (msg->mentions_set) {
+        json_key(f_json, "allowed_mentions");
+        json_open_list(f_json);
+        json_key(f_json, "parse");
+        json_open_array(f_json);
+        if (msg->mentions & DISCORD_MENTION_USERS) {
+            json_string(f_json, "users");
         }
+        if (msg->mentions & DISCORD_MENTION_ROLES) {
+            json_string(f_json, "roles");
+        }
+        if (msg->mentions & DISCORD_MENTION_EVERYONE) {
+            json_string(f_json, "everyone");
+        }
+        json_close_array(f_json);
+        json_close_list(f_json);
+    }
+}
 
-        json_key(&f_json, "color");
-        char str[12];
-        sprintf(str, "%d", REST_COLOR);
-        json_value(&f_json, str);
+// Runs on the HTTP task, the message is written through its stream buffer
+static bool discord_message_serialize(const void *body, char *buffer, size_t size, http_chunk_writer write, void *ctx) {
+    json_object_t f_json = json_init_stream(buffer, size, write, ctx);
+    discord_json_write_content(&f_json, body);
+    return json_finish(&f_json).ptr != NULL;
+}
 
-        json_close_list(&f_json);
+// Text only messages are rendered now, anything with an embed becomes a message that the HTTP task serializes
+// Returns the body and sets whether it needs serializing, NULL if it could not be allocated
+static char *discord_message_body(const char *content, const char *title, const char *description, const char *author,
+                                  const char *author_icon_url, const char *footer, const char *footer_icon_url, bool embed_list,
+                                  http_body_serializer *serialize) {
+    *serialize = NULL;
+    if (title == NULL && description == NULL && author == NULL && footer == NULL) {
+        const json_slot_t values[] = {{.string = content != NULL ? content : ""}};
+        char *body = json_template_alloc(DISC_TEXT_TPL, JSON_TEMPLATE_LENGTH(DISC_TEXT_TPL), values);
+        if (body == NULL) {
+            ESP_LOGE(DISC_TAG, "Could not allocate a message body");
+        }
+        return body;
+    }
+
+    const char *fields[] = {content, title, description, author, author_icon_url, footer, footer_icon_url};
+    size_t size = sizeof(discord_embed_t) + REST_ARENA_ALIGN;
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        if (fields[i] != NULL) {
+            size += strlen(fields[i]) + 1;
+        }
+    }
+    discord_message_t *msg = discord_message_new(size);
+    if (msg == NULL) {
+        return NULL;
     }
+    discord_message_set_content(msg, content);
+    discord_embed_t *embed = discord_message_add_embed(msg);
+    discord_embed_set_title(embed, title);
+    discord_embed_set_description(embed, description);
+    discord_embed_set_author(embed, author, author_icon_url);
+    discord_embed_set_footer(embed, footer, footer_icon_url);
+    msg->embed_list = embed_list;
+    *serialize = discord_message_serialize;
+    return (char *)msg;
+}
 
-    return json_finish(&f_json);
+// Reads the configured announcement channel and registers its webhook, a webhook URL ends in /webhooks/<id>/<token>
+static esp_err_t discord_announce_init(void) {
+    const char *channel = REST_ANNOUNCE_CHANNEL;
+    const char *url = REST_ANNOUNCE_WEBHOOK;
+    if (channel[0] == '\0') {
+        if (url[0] != '\0') {
+            ESP_LOGW(DISC_TAG, "The announcement webhook is not used without the id of its channel");
+        }
+        return ESP_OK;
+    }
+    if (!string_to_u64(channel, strlen(channel), &DISC_announce_channel)) {
+        ESP_LOGE(DISC_TAG, "The announcement channel is not a channel id: %s", channel);
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (url[0] == '\0') {
+        return ESP_OK;
+    }
+    const char *id = strstr(url, REST_WEBHOOK_URL_PATH);
+    if (id != NULL) {
+        id += strlen(REST_WEBHOOK_URL_PATH);
+    }
+    const char *slash = id != NULL ? strchr(id, '/') : NULL;
+    uint64_t webhook_id;
+    if (slash == NULL || !string_to_u64(id, slash - id, &webhook_id)) {
+        ESP_LOGE(DISC_TAG, "The announcement webhook URL does not end in " REST_WEBHOOK_URL_PATH "<id>/<token>");
+        return ESP_ERR_INVALID_ARG;
+    }
+    char token[HTTP_MAX_PATH];
+    size_t token_len = strcspn(slash + 1, "/?");
+    if (token_len == 0 || token_len >= sizeof(token)) {
+        ESP_LOGE(DISC_TAG, "The announcement webhook URL has no usable token");
+        return ESP_ERR_INVALID_ARG;
+    }
+    memcpy(token, slash + 1, token_len);
+    token[token_len] = '\0';
+    return discord_set_webhook(DISC_announce_channel, webhook_id, token);
 }
 
 extern esp_err_t discord_init(const char *bot_token) {
@@ -93,14 +386,373 @@ extern esp_err_t discord_init(const char *bot_token) {
     char *authToken_buf = calloc(1, length);
     snprintf(authToken_buf, length, "%s%s", REST_AUTH_PREFIX, bot_token);
 
+    DISC_webhook_lock = xSemaphoreCreateMutex();
+    if (DISC_webhook_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    discord_announce_init(); // announcements fall back to the bot token if it fails
+
     ESP_LOGI(DISC_TAG, "Initalizing HTTP POST");
     return http_init(authToken_buf);
 }
 
-extern void discord_send_message(const char *content, const char *title, const char *description, const char *author,
-                                 const char *author_icon_url, const char *footer, const char *footer_icon_url, const char *channel_id) {
+extern esp_err_t discord_send_message_cb(const char *content, const char *title, const char *description, const char *author,
+                                         const char *author_icon_url, const char *footer, const char *footer_icon_url, uint64_t channel_id,
+                                         discord_message_handler on_sent, void *ctx) {
+
+    discord_sent_ctx_t *sent;
+    if (discord_sent_ctx_new(on_sent, ctx, &sent) != ESP_OK) {
+        return ESP_ERR_NO_MEM;
+    }
+    http_body_serializer serialize;
+    char *body = discord_message_body(content, title, description, author, author_icon_url, footer, footer_icon_url, false, &serialize);
+    if (body == NULL) { // nothing is sent, an empty request would only spend a rate limit slot
+        if (sent != NULL) {
+            discord_message_sent(-1, NULL, 0, sent);
+        }
+        return ESP_ERR_NO_MEM;
+    }
+    return discord_rest_request(HTTP_METHOD_POST, HTTP_PRIORITY_NORMAL, REST_PATH, channel_id, 0, body, serialize,
+                                sent != NULL ? discord_message_sent : NULL, sent);
+}
+
+extern esp_err_t discord_send_message(const char *content, const char *title, const char *description, const char *author,
+                                      const char *author_icon_url, const char *footer, const char *footer_icon_url, uint64_t channel_id) {
+    return discord_send_message_cb(content, title, description, author, author_icon_url, footer, footer_icon_url, channel_id, NULL, NULL);
+}
+
+extern esp_err_t discord_edit_message(const char *content, const char *title, const char *description, const char *author,
+                                      const char *author_icon_url, const char *footer, const char *footer_icon_url, uint64_t channel_id,
+                                      uint64_t message_id, discord_priority_t priority) {
+
+    http_body_serializer serialize;
+    char *body = discord_message_body(content, title, description, author, author_icon_url, footer, footer_icon_url, false, &serialize);
+    if (body == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    return discord_rest_request(HTTP_METHOD_PATCH, discord_http_priority(priority), REST_MESSAGE_PATH, channel_id, message_id, body, serialize,
+                                NULL, NULL);
+}
+
+extern esp_err_t discord_delete_message(uint64_t channel_id, uint64_t message_id) {
+    return discord_rest_request(HTTP_METHOD_DELETE, HTTP_PRIORITY_NORMAL, REST_MESSAGE_PATH, channel_id, message_id, NULL, NULL, NULL, NULL);
+}
+
+// Requests copy the path when they are queued, so a webhook can be replaced at any time after discord_init
+extern esp_err_t discord_set_webhook(uint64_t channel_id, uint64_t webhook_id, const char *webhook_token) {
+    if (DISC_webhook_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    char id[HTTP_ID_LENGTH];
+    id[string_from_u64(id, webhook_id)] = '\0';
+    char path[HTTP_MAX_PATH];
+    int len = snprintf(path, sizeof(path), REST_WEBHOOK_PATH REST_WEBHOOK_QUERY, id, webhook_token);
+    if (len < 0 || len >= HTTP_MAX_PATH) {
+        ESP_LOGE(DISC_TAG, "The path of webhook %llu does not fit in %d bytes", (unsigned long long)webhook_id, HTTP_MAX_PATH);
+        return ESP_ERR_INVALID_ARG;
+    }
+    xSemaphoreTake(DISC_webhook_lock, portMAX_DELAY);
+    discord_webhook_t *webhook = NULL;
+    for (int i = 0; i < DISC_webhook_count; i++) {
+        if (DISC_webhooks[i].channel_id == channel_id) {
+            webhook = &DISC_webhooks[i];
+        }
+    }
+    if (webhook == NULL) {
+        if (DISC_webhook_count == REST_MAX_WEBHOOKS) {
+            xSemaphoreGive(DISC_webhook_lock);
+            ESP_LOGE(DISC_TAG, "No room for another webhook");
+            return ESP_ERR_NO_MEM;
+        }
+        webhook = &DISC_webhooks[DISC_webhook_count++];
+    }
+    ESP_LOGI(DISC_TAG, "Announcements to channel %llu go through webhook %llu", (unsigned long long)channel_id, (unsigned long long)webhook_id);
+    webhook->channel_id = channel_id;
+    webhook->webhook_id = webhook_id;
+    memcpy(webhook->path, path, len + 1);
+    xSemaphoreGive(DISC_webhook_lock);
+    return ESP_OK;
+}
+
+// The copy of the path of the channel's webhook, NULL if it has none or the copy failed
+static char *discord_webhook_path(uint64_t channel_id, uint64_t *webhook_id) {
+    char *path = NULL;
+    xSemaphoreTake(DISC_webhook_lock, portMAX_DELAY);
+    for (int i = 0; i < DISC_webhook_count; i++) {
+        if (DISC_webhooks[i].channel_id == channel_id) {
+            *webhook_id = DISC_webhooks[i].webhook_id;
+            path = strdup(DISC_webhooks[i].path);
+            break;
+        }
+    }
+    xSemaphoreGive(DISC_webhook_lock);
+    return path;
+}
+
+extern uint64_t discord_announce_channel(void) {
+    return DISC_announce_channel;
+}
+
+// Announcements are low priority, they use a webhook when the channel has one so they have their own rate limit
+extern esp_err_t discord_send_announcement(const char *content, const char *title, const char *description, const char *author,
+                                           const char *author_icon_url, const char *footer, const char *footer_icon_url,
+                                           uint64_t channel_id) {
+    http_body_serializer serialize;
+    uint64_t webhook_id;
+    char *path = discord_webhook_path(channel_id, &webhook_id);
+    if (path != NULL) {
+        // The route only names the rate limit bucket, the path is requested as is and never goes through the path cache
+        http_request_t request = {
+            .method = HTTP_METHOD_POST,
+            .priority = HTTP_PRIORITY_LOW,
+            .route = REST_WEBHOOK_PATH,
+            .path = path,
+            .no_auth = true,
+        };
+        request.body = discord_message_body(content, title, description, author, author_icon_url, footer, footer_icon_url, true, &request.serialize);
+        if (request.body == NULL) {
+            free(path);
+            return ESP_ERR_NO_MEM;
+        }
+        return discord_rest_queue(&request, webhook_id, 0);
+    }
+    char *body = discord_message_body(content, title, description, author, author_icon_url, footer, footer_icon_url, false, &serialize);
+    if (body == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    return discord_rest_request(HTTP_METHOD_POST, HTTP_PRIORITY_LOW, REST_PATH, channel_id, 0, body, serialize, NULL, NULL);
+}
+
+extern discord_message_t *discord_message_new(size_t arena_size) {
+    if (arena_size == 0) {
+        arena_size = REST_MESSAGE_ARENA;
+    }
+    discord_message_t *msg = malloc(sizeof(discord_message_t) + arena_size);
+    if (msg == NULL) {
+        ESP_LOGE(DISC_TAG, "Could not allocate a %u byte message", (unsigned)arena_size);
+        return NULL;
+    }
+    memset(msg, 0, sizeof(discord_message_t));
+    msg->size = arena_size;
+    return msg;
+}
+
+extern void discord_message_free(discord_message_t *msg) {
+    free(msg);
+}
+
+extern void discord_message_set_content(discord_message_t *msg, const char *content) {
+    msg->content = discord_arena_strdup(msg, content);
+}
+
+// Without this discord's default applies, any mention in the content pings
+extern void discord_message_allow_mentions(discord_message_t *msg, uint8_t mentions) {
+    msg->mentions_set = true;
+    msg->mentions = mentions;
+}
+
+// Returns NULL once the arena is full, the embed setters accept NULL so calls can be chained without checks
+extern discord_embed_t *discord_message_add_embed(discord_message_t *msg) {
+    discord_embed_t *embed = discord_arena_alloc(msg, sizeof(discord_embed_t), REST_ARENA_ALIGN);
+    if (embed == NULL) {
+        return NULL;
+    }
+    memset(embed, 0, sizeof(discord_embed_t));
+    embed->message = msg;
+    embed->color = REST_COLOR;
+    if (msg->last_embed != NULL) {
+        msg->last_embed->next = embed;
+    } else {
+        msg->embeds = embed;
+    }
+    msg->last_embed = embed;
+    msg->embed_count++;
+    return embed;
+}
+
+extern void discord_embed_set_title(discord_embed_t *embed, const char *title) {
+    if (embed != NULL) {
+        embed->title = discord_arena_strdup(embed->message, title);
+    }
+}
+
+extern void discord_embed_set_description(discord_embed_t *embed, const char *description) {
+    if (embed != NULL) {
+        embed->description = discord_arena_strdup(embed->message, description);
+    }
+}
+
+extern void discord_embed_set_url(discord_embed_t *embed, const char *url) {
+    if (embed != NULL) {
+        embed->url = discord_arena_strdup(embed->message, url);
+    }
+}
+
+extern void discord_embed_set_color(discord_embed_t *embed, long color) {
+    if (embed != NULL) {
+        embed->color = color;
+    }
+}
+
+extern void discord_embed_set_timestamp(discord_embed_t *embed, time_t timestamp) {
+    if (embed == NULL) {
+        return;
+    }
+    struct tm utc;
+    char iso[sizeof("1970-01-01T00:00:00Z")];
+    gmtime_r(&timestamp, &utc);
+    strftime(iso, sizeof(iso), "%Y-%m-%dT%H:%M:%SZ", &utc);
+    embed->timestamp = discord_arena_strdup(embed->message, iso);
+}
+
+extern void discord_embed_set_thumbnail(discord_embed_t *embed, const char *url) {
+    if (embed != NULL) {
+        embed->thumbnail_url = discord_arena_strdup(embed->message, url);
+    }
+}
+
+extern void discord_embed_set_image(discord_embed_t *embed, const char *url) {
+    if (embed != NULL) {
+        embed->image_url = discord_arena_strdup(embed->message, url);
+    }
+}
+
+extern void discord_embed_set_author(discord_embed_t *embed, const char *name, const char *icon_url) {
+    if (embed != NULL) {
+        embed->author = discord_arena_strdup(embed->message, name);
+        embed->author_icon_url = discord_arena_strdup(embed->message, icon_url);
+    }
+}
+
+extern void discord_embed_set_footer(discord_embed_t *embed, const char *text, const char *icon_url) {
+    if (embed != NULL) {
+        embed->footer = discord_arena_strdup(embed->message, text);
+        embed->footer_icon_url = discord_arena_strdup(embed->message, icon_url);
+    }
+}
+
+extern void discord_embed_add_field(discord_embed_t *embed, const char *name, const char *value, bool inline_field) {
+    if (embed == NULL) {
+        return;
+    }
+    discord_field_t *field = discord_arena_alloc(embed->message, sizeof(discord_field_t), REST_ARENA_ALIGN);
+    if (field == NULL) {
+        return;
+    }
+    field->name = discord_arena_strdup(embed->message, name);
+    field->value = discord_arena_strdup(embed->message, value);
+    field->inline_field = inline_field;
+    field->next = NULL;
+    if (embed->last_field != NULL) {
+        embed->last_field->next = field;
+    } else {
+        embed->fields = field;
+    }
+    embed->last_field = field;
+}
+
+// Queue a built message, the message belongs to the HTTP task afterwards even if queueing fails
+static esp_err_t discord_message_queue(esp_http_client_method_t method, http_priority_t priority, const char *route,
+                                       discord_message_t *msg, uint64_t channel_id, uint64_t message_id,
+                                       http_response_handler on_complete, void *ctx) {
+    if (msg->failed) {
+        ESP_LOGE(DISC_TAG, "Message did not fit in its %u byte arena", (unsigned)msg->size);
+        if (on_complete != NULL) {
+            on_complete(-1, NULL, 0, ctx);
+        }
+        discord_message_free(msg);
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGD(DISC_TAG, "Message uses %u of %u arena bytes", (unsigned)msg->used, (unsigned)msg->size);
+    return discord_rest_request(method, priority, route, channel_id, message_id, (char *)msg, discord_message_serialize, on_complete, ctx);
+}
+
+extern esp_err_t discord_message_send(discord_message_t *msg, uint64_t channel_id, discord_message_handler on_sent, void *ctx) {
+    discord_sent_ctx_t *sent;
+    if (discord_sent_ctx_new(on_sent, ctx, &sent) != ESP_OK) {
+        discord_message_free(msg);
+        return ESP_ERR_NO_MEM;
+    }
+    return discord_message_queue(HTTP_METHOD_POST, HTTP_PRIORITY_NORMAL, REST_PATH, msg, channel_id, 0,
+                                 sent != NULL ? discord_message_sent : NULL, sent);
+}
+
+extern esp_err_t discord_message_edit(discord_message_t *msg, uint64_t channel_id, uint64_t message_id, discord_priority_t priority) {
+    return discord_message_queue(HTTP_METHOD_PATCH, discord_http_priority(priority), REST_MESSAGE_PATH, msg, channel_id, message_id, NULL, NULL);
+}
+
+// Replies are rendered to their final body once, sending one only takes another reference to it
+extern discord_reply_t *discord_reply_text(const char *content) {
+    const json_slot_t values[] = {{.string = content != NULL ? content : ""}};
+    size_t len = json_template_size(DISC_TEXT_TPL, JSON_TEMPLATE_LENGTH(DISC_TEXT_TPL), values);
+    discord_reply_t *reply = http_shared_body_new(len);
+    if (reply == NULL) {
+        ESP_LOGE(DISC_TAG, "Could not allocate a %u byte reply", (unsigned)len);
+        return NULL;
+    }
+    json_template_render(DISC_TEXT_TPL, JSON_TEMPLATE_LENGTH(DISC_TEXT_TPL), values, reply->data, len + 1);
+    return reply;
+}
+
+static bool discord_reply_copy_chunk(const char *data, size_t len, void *ctx) {
+    char **out = ctx;
+    memcpy(*out, data, len);
+    *out += len;
+    return true;
+}
+
+// Takes ownership of the message, it is measured then written straight into the reply and freed
+extern discord_reply_t *discord_reply_message(discord_message_t *msg) {
+    char buffer[64]; // HTTP_stream_buffer belongs to the HTTP task
+    size_t len = 0;
+    discord_reply_t *reply = NULL;
+    if (msg->failed) {
+        ESP_LOGE(DISC_TAG, "Message did not fit in its %u byte arena", (unsigned)msg->size);
+    } else if (discord_message_serialize(msg, buffer, sizeof(buffer), http_count_chunk, &len) && (reply = http_shared_body_new(len)) != NULL) {
+        char *out = reply->data;
+        discord_message_serialize(msg, buffer, sizeof(buffer), discord_reply_copy_chunk, &out);
+    }
+    discord_message_free(msg);
+    return reply;
+}
+
+// The caller keeps its reference, the queued request holds its own until it is done
+extern esp_err_t discord_reply_send_cb(discord_reply_t *reply, uint64_t channel_id, discord_message_handler on_sent, void *ctx) {
+    if (reply == NULL) {
+        if (on_sent != NULL) {
+            on_sent(0, 0, ctx);
+        }
+        return ESP_ERR_INVALID_ARG;
+    }
+    discord_sent_ctx_t *sent;
+    if (discord_sent_ctx_new(on_sent, ctx, &sent) != ESP_OK) {
+        return ESP_ERR_NO_MEM;
+    }
+    http_request_t request = {
+        .method = HTTP_METHOD_POST,
+        .priority = HTTP_PRIORITY_NORMAL,
+        .route = REST_PATH,
+        .shared = http_shared_body_retain(reply),
+        .on_complete = sent != NULL ? discord_message_sent : NULL,
+        .ctx = sent,
+    };
+    return discord_rest_queue(&request, channel_id, 0);
+}
+
+extern esp_err_t discord_reply_send(discord_reply_t *reply, uint64_t channel_id) {
+    return discord_reply_send_cb(reply, channel_id, NULL, NULL);
+}
+
+// Drops the caller's reference, requests still waiting to send it keep it alive
+extern void discord_reply_release(discord_reply_t *reply) {
+    http_shared_body_release(reply);
+}
 
-    char *json_content = discord_json_build_content(content, title, description, author, author_icon_url, footer, footer_icon_url);
-    discord_rest_post(json_content, channel_id);
-    free(json_content);
+extern void discord_get_queue_stats(discord_queue_stats_t *stats) {
+    http_queue_stats_t http_stats;
+    http_get_queue_stats(&http_stats);
+    stats->queued = http_stats.queued;
+    stats->rejected = http_stats.rejected;
+    stats->dropped = http_stats.dropped;
+    stats->high_water = http_stats.high_water;
 }
\ No newline at end of file
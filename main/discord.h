@@ -1,18 +1,107 @@
 #ifndef __DISCORD_H__
 #define __DISCORD_H__
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 
 #include "esp_event.h"
 #include "esp_log.h"
 
 #define discord_send_text_message(content, channel_id) discord_send_message(content, NULL, NULL, NULL, NULL, NULL, NULL, channel_id)
 #define discord_send_basic_embed(title, description, channel_id) discord_send_message(NULL, title, description, NULL, NULL, NULL, NULL, channel_id)
+#define discord_edit_text_message(content, channel_id, message_id, priority)                                                          \
+    discord_edit_message(content, NULL, NULL, NULL, NULL, NULL, NULL, channel_id, message_id, priority)
+
+// Ids are snowflakes, they are only formatted as text when a request is sent
+
+// Called once a sent message was created, ids are 0 if it failed or was never sent
+typedef void (*discord_message_handler)(uint64_t channel_id, uint64_t message_id, void *ctx);
+
+// Who may be pinged by the mentions in a message, see discord_message_allow_mentions
+typedef enum discord_mention {
+    DISCORD_MENTION_NONE = 0,
+    DISCORD_MENTION_USERS = 1 << 0,
+    DISCORD_MENTION_ROLES = 1 << 1,
+    DISCORD_MENTION_EVERYONE = 1 << 2,
+} discord_mention_t;
+
+// Edits of a message that keeps changing are low priority, a newer edit supersedes one that is dropped
+// An edit that nothing will follow, such as the final answer of a command, must not be dropped
+typedef enum discord_priority {
+    DISCORD_PRIORITY_NORMAL,
+    DISCORD_PRIORITY_LOW, // may be dropped to make room when the request queue is full
+} discord_priority_t;
+
+// A message built up piece by piece, all of its strings are copied into its own arena
+typedef struct discord_message discord_message_t;
+typedef struct discord_embed discord_embed_t;
+
+// A request body rendered once and shared by reference between every request that sends it
+typedef struct http_shared_body discord_reply_t;
+
+typedef struct discord_queue_stats {
+    uint32_t queued;
+    uint32_t rejected;
+    uint32_t dropped;
+    uint32_t high_water;
+} discord_queue_stats_t;
 
 extern esp_err_t discord_init(const char *bot_token);
 
-extern void discord_send_message(const char *content, const char *title, const char *description, const char *author,
-                                 const char *author_icon_url, const char *footer, const char *footer_icon_url, const char *channel_id);
+extern esp_err_t discord_send_message(const char *content, const char *title, const char *description, const char *author,
+                                      const char *author_icon_url, const char *footer, const char *footer_icon_url, uint64_t channel_id);
+
+extern esp_err_t discord_send_message_cb(const char *content, const char *title, const char *description, const char *author,
+                                         const char *author_icon_url, const char *footer, const char *footer_icon_url, uint64_t channel_id,
+                                         discord_message_handler on_sent, void *ctx);
+
+extern esp_err_t discord_edit_message(const char *content, const char *title, const char *description, const char *author,
+                                      const char *author_icon_url, const char *footer, const char *footer_icon_url, uint64_t channel_id,
+                                      uint64_t message_id, discord_priority_t priority);
+
+extern esp_err_t discord_delete_message(uint64_t channel_id, uint64_t message_id);
+
+extern esp_err_t discord_set_webhook(uint64_t channel_id, uint64_t webhook_id, const char *webhook_token);
+
+extern uint64_t discord_announce_channel(void); // the configured announcement channel, 0 if there is none
+
+extern esp_err_t discord_send_announcement(const char *content, const char *title, const char *description, const char *author,
+                                           const char *author_icon_url, const char *footer, const char *footer_icon_url,
+                                           uint64_t channel_id);
+
+extern void discord_get_queue_stats(discord_queue_stats_t *stats);
+
+// arena_size 0 uses the configured default, anything that does not fit fails the message when it is sent
+extern discord_message_t *discord_message_new(size_t arena_size);
+extern void discord_message_free(discord_message_t *msg); // only for messages that are never sent
+extern void discord_message_set_content(discord_message_t *msg, const char *content);
+extern void discord_message_allow_mentions(discord_message_t *msg, uint8_t mentions);
+extern discord_embed_t *discord_message_add_embed(discord_message_t *msg);
+
+extern void discord_embed_set_title(discord_embed_t *embed, const char *title);
+extern void discord_embed_set_description(discord_embed_t *embed, const char *description);
+extern void discord_embed_set_url(discord_embed_t *embed, const char *url);
+extern void discord_embed_set_color(discord_embed_t *embed, long color);
+extern void discord_embed_set_timestamp(discord_embed_t *embed, time_t timestamp);
+extern void discord_embed_set_thumbnail(discord_embed_t *embed, const char *url);
+extern void discord_embed_set_image(discord_embed_t *embed, const char *url);
+extern void discord_embed_set_author(discord_embed_t *embed, const char *name, const char *icon_url);
+extern void discord_embed_set_footer(discord_embed_t *embed, const char *text, const char *icon_url);
+extern void discord_embed_add_field(discord_embed_t *embed, const char *name, const char *value, bool inline_field);
+
+// Both take ownership of the message, its arena is freed in one go once the request is done
+extern esp_err_t discord_message_send(discord_message_t *msg, uint64_t channel_id, discord_message_handler on_sent, void *ctx);
+extern esp_err_t discord_message_edit(discord_message_t *msg, uint64_t channel_id, uint64_t message_id, discord_priority_t priority);
+
+// Rendered once, eg. at init, and sent any number of times without being serialized or copied again
+// To replace a reply, create the new one before releasing the old one from the task that sends it
+extern discord_reply_t *discord_reply_text(const char *content);
+extern discord_reply_t *discord_reply_message(discord_message_t *msg); // takes ownership of the message
+extern esp_err_t discord_reply_send(discord_reply_t *reply, uint64_t channel_id);
+extern esp_err_t discord_reply_send_cb(discord_reply_t *reply, uint64_t channel_id, discord_message_handler on_sent, void *ctx);
+extern void discord_reply_release(discord_reply_t *reply);
 
 #endif // __DISCORD_H__
\ No newline at end of file
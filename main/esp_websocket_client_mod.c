@@ -34,6 +34,8 @@
 #include "freertos/semphr.h"
 #include "freertos/task.h"
 #include "http_parser.h"
+#include "mem_place.h"
+#include "tls_shared.h"
 
 typedef struct esp_websocket_client *esp_websocket_client_handle_t;
 
@@ -95,6 +97,7 @@ typedef struct {
     char *headers;                       /*!< Websocket additional headers */
     int pingpong_timeout_sec;            /*!< Period before connection is aborted due to no PONGs received */
     bool disable_pingpong_discon;        /*!< Disable auto-disconnect due to no PONG received within pingpong_timeout_sec */
+    bool shared_tls;                     /*!< Verify with and handshake through the setup shared with the HTTP client, see tls_shared.c */
 
 } esp_websocket_client_config_t;
 
@@ -144,6 +147,7 @@ typedef struct {
     char *user_agent;
     char *headers;
     int pingpong_timeout_sec;
+    bool shared_tls;
 } websocket_config_storage_t;
 
 typedef enum {
@@ -402,6 +406,7 @@ static esp_err_t esp_websocket_client_set_config(esp_websocket_client_handle_t c
         ESP_WS_CLIENT_MEM_CHECK(TAG, cfg->headers, return ESP_ERR_NO_MEM);
     }
 
+    cfg->shared_tls = config->shared_tls;
     cfg->network_timeout_ms = WEBSOCKET_NETWORK_TIMEOUT_MS;
     cfg->user_context = config->user_context;
     cfg->auto_reconnect = true;
@@ -504,6 +509,8 @@ esp_websocket_client_handle_t esp_websocket_client_init(const esp_websocket_clie
     esp_transport_set_default_port(ssl, WEBSOCKET_SSL_DEFAULT_PORT);
     if (config->cert_pem) {
         esp_transport_ssl_set_cert_data(ssl, config->cert_pem, strlen(config->cert_pem));
+    } else if (config->shared_tls) {
+        tls_shared_ssl_transport(ssl);
     }
     esp_transport_list_add(client->transport_list, ssl, "_ssl"); // need to save to transport list, for cleanup
 
@@ -547,11 +554,11 @@ esp_websocket_client_handle_t esp_websocket_client_init(const esp_websocket_clie
     if (buffer_size <= 0) {
         buffer_size = WEBSOCKET_BUFFER_SIZE_BYTE;
     }
-    client->rx_buffer = malloc(buffer_size);
+    client->rx_buffer = mem_place_alloc("websocket rx", buffer_size, MEM_BULK);
     ESP_WS_CLIENT_MEM_CHECK(TAG, client->rx_buffer, {
         goto _websocket_init_fail;
     });
-    client->tx_buffer = malloc(buffer_size);
+    client->tx_buffer = mem_place_alloc("websocket tx", buffer_size, MEM_INTERNAL); // encrypted straight from here on every send
     ESP_WS_CLIENT_MEM_CHECK(TAG, client->tx_buffer, {
         goto _websocket_init_fail;
     });
@@ -581,8 +588,8 @@ esp_err_t esp_websocket_client_destroy(esp_websocket_client_handle_t client) {
     esp_websocket_client_destroy_config(client);
     esp_transport_list_destroy(client->transport_list);
     vQueueDelete(client->lock);
-    free(client->tx_buffer);
-    free(client->rx_buffer);
+    mem_place_free(client->tx_buffer);
+    mem_place_free(client->rx_buffer);
     if (client->status_bits) {
         vEventGroupDelete(client->status_bits);
     }
@@ -714,10 +721,17 @@ static void esp_websocket_client_task(void *pv) {
                 client->run = false;
                 break;
             }
-            if (esp_transport_connect(client->transport,
-                                      client->config->host,
-                                      client->config->port,
-                                      client->config->network_timeout_ms) < 0) {
+            if (client->config->shared_tls) {
+                tls_handshake_begin();
+            }
+            int connected = esp_transport_connect(client->transport,
+                                                  client->config->host,
+                                                  client->config->port,
+                                                  client->config->network_timeout_ms);
+            if (client->config->shared_tls) {
+                tls_handshake_end();
+            }
+            if (connected < 0) {
                 ESP_LOGE(TAG, "Error transport connect");
                 esp_websocket_client_abort_connection(client);
                 break;
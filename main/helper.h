@@ -1,36 +1,81 @@
 #ifndef __HELPER_H__
 #define __HELPER_H__
 
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+// Whether string starts with stringMaster, both are walked once
 static bool string_match(const char *string, const char *stringMaster) {
-    int i;
-    bool val = true;
-    for (i = 0; i < strlen(stringMaster); i++) {
+    for (; *stringMaster != '\0'; string++, stringMaster++) {
 #ifdef CONFIG_BOT_CASE_SENSITIVE
-        if (*(string + i) != *(stringMaster + i)) {
+        if (*string != *stringMaster) {
 #else
-        if (tolower(string[i]) != tolower(stringMaster[i])) {
+        if (tolower((unsigned char)*string) != tolower((unsigned char)*stringMaster)) {
 #endif
-            val = false;
-            break;
+            return false; // also stops at the end of string, '\0' never matches
         }
     }
-    return val;
+    return true;
 }
 
-static void string_strip(char *string) {
-    int i;
-    int k = 0;
-    for (i = 0; i < strlen(string); i++) {
-        if (string[i] != ' ' && string[i] != '\0') {
-            string[k] = string[i];
-            k++;
+// Parse exactly len digits, false if there are none, anything else or it overflows
+static bool string_to_u64(const char *string, size_t len, uint64_t *value) {
+    uint64_t result = 0;
+    if (len == 0) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        unsigned digit = (unsigned char)string[i] - '0';
+        if (digit > 9 || result > (UINT64_MAX - digit) / 10) {
+            return false;
         }
+        result = result * 10 + digit;
+    }
+    *value = result;
+    return true;
+}
+
+static const char STRING_DIGITS[] = "00010203040506070809"
+                                    "10111213141516171819"
+                                    "20212223242526272829"
+                                    "30313233343536373839"
+                                    "40414243444546474849"
+                                    "50515253545556575859"
+                                    "60616263646566676869"
+                                    "70717273747576777879"
+                                    "80818283848586878889"
+                                    "90919293949596979899";
+
+static inline int string_u64_digits(uint64_t value) {
+    int digits = 1;
+    while (value >= 10) {
+        value /= 10;
+        digits++;
+    }
+    return digits;
+}
+
+// Write a number without a terminator, two digits at a time from the end, returns the length
+static int string_from_u64(char *out, uint64_t value) {
+    int len = string_u64_digits(value);
+    char *end = out + len;
+    while (value >= 100) {
+        int pair = (value % 100) * 2;
+        value /= 100;
+        *--end = STRING_DIGITS[pair + 1];
+        *--end = STRING_DIGITS[pair];
+    }
+    if (value >= 10) {
+        *--end = STRING_DIGITS[value * 2 + 1];
+        *--end = STRING_DIGITS[value * 2];
+    } else {
+        *--end = '0' + value;
     }
-    string[k] = '\0';
+    return len;
 }
 
-#endif // __HELPER_H__
\ No newline at end of file
+#endif // __HELPER_H__
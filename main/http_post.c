@@ -2,100 +2,524 @@
 #include "esp_log.h"
 #include "esp_netif.h"
 #include "esp_system.h"
+#include "esp_timer.h"
 #include "esp_tls.h"
 #include "nvs_flash.h"
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "freertos/task.h"
 
 #include "esp_http_client.h"
+#include "helper.h"
+#include "mem_place.h"
+#include "tls_shared.h"
+#include "trace.h"
 
 #define HTTP_MAX_BUFFER CONFIG_HTTP_MAX_BUFFER
 #define HTTP_HOST CONFIG_HTTP_HOST
-#define HTTP_MAX_QUEUE CONFIG_WEBSOCKET_QUEUE_SIZE
+#define HTTP_MAX_QUEUE CONFIG_HTTP_QUEUE_SIZE
+#define HTTP_QUEUE_TIMEOUT CONFIG_HTTP_QUEUE_TIMEOUT_MS
+#define HTTP_MAX_PATH 128
+#define HTTP_ID_LENGTH 24 // snowflakes are at most 20 digits
+#define HTTP_PATH_CACHE_SIZE CONFIG_HTTP_PATH_CACHE_SIZE
+#define HTTP_BUCKET_COUNT 8 // rate limit buckets that are tracked at once
+#define HTTP_MAX_RETRIES 2  // times a rate limited request is sent again
+#define HTTP_STREAM_BUFFER CONFIG_HTTP_STREAM_BUFFER
 
 static const char HTTP_TAG[] = "HTTP";
 static const char *authHeader;
-static char local_response_buffer[HTTP_MAX_BUFFER] = {0};
+static char *local_response_buffer; // HTTP_MAX_BUFFER, placed on init
+static int local_response_len;
+static char HTTP_stream_buffer[HTTP_STREAM_BUFFER]; // scratch space streamed bodies are serialized through
+static bool http_connected; // whether the next request reuses the open connection
 static QueueHandle_t HTTP_POST_Queue;
+static SemaphoreHandle_t HTTP_admission_lock; // only one producer may try the queue and drop from it at a time, never held while blocking
+static SemaphoreHandle_t HTTP_queue_slots;    // a request holds one from when it is queued until it is done, so a requeue always fits
 
-typedef struct http_post_data {
-    char *jsonContent;
-    char *path;
-} http_post_data_t;
+// Called from the HTTP task once a request is done, status is -1 if the request never completed
+typedef void (*http_response_handler)(int status, const char *response, int len, void *ctx);
 
-static inline void clean_post_data(http_post_data_t *postData) {
-    free(postData->jsonContent);
-    free(postData->path);
+// Sends part of a streamed body, returns false if it could not be sent
+typedef bool (*http_chunk_writer)(const char *data, size_t len, void *ctx);
+
+// Serializes a body that was queued as a descriptor, it is called once to measure the body and once to send it
+typedef bool (*http_body_serializer)(const void *body, char *buffer, size_t size, http_chunk_writer write, void *ctx);
+
+// An immutable body that any number of queued requests point to, freed when the last reference is released
+typedef struct http_shared_body {
+    uint32_t refs;
+    size_t len;
+    char data[]; // terminated
+} http_shared_body_t;
+
+typedef enum http_priority {
+    HTTP_PRIORITY_NORMAL,
+    HTTP_PRIORITY_LOW, // may be dropped to make room when the queue is full
+} http_priority_t;
+
+typedef struct http_request {
+    esp_http_client_method_t method;
+    http_priority_t priority;
+    const char *route;           // path template, formatted with major then minor
+    char *path;                  // if set, requested instead of the formatted route and freed with the request
+    bool no_auth;                // the path carries its own credentials, the bot token is left out
+    uint64_t major;              // major parameter of the route (channel id)
+    uint64_t minor;              // optional second parameter of the route (message id), 0 if there is none
+    char *body;                  // json body, NULL for requests without one
+    http_body_serializer serialize; // if set, body is a descriptor that is serialized while it is sent
+    http_shared_body_t *shared;     // if set, sent instead of body and released once the request is done
+    uint8_t retries;
+    http_response_handler on_complete;
+    void *ctx;
+    uint64_t trace_id; // message the request was sent for, see trace.h
+} http_request_t;
+
+typedef struct http_queue_stats {
+    uint32_t queued;     // requests admitted to the queue
+    uint32_t rejected;   // requests refused because the queue stayed full
+    uint32_t dropped;    // low priority requests evicted to make room
+    uint32_t high_water; // most requests that were waiting at once
+} http_queue_stats_t;
+
+static http_queue_stats_t HTTP_queue_stats;
+
+// Formatted paths of recently used routes, only touched by the HTTP task
+typedef struct http_path_entry {
+    const char *route;
+    uint64_t major;
+    uint64_t minor;
+    char path[HTTP_MAX_PATH];
+    uint32_t last_used; // 0 if the entry is empty
+} http_path_entry_t;
+
+static http_path_entry_t HTTP_path_cache[HTTP_PATH_CACHE_SIZE];
+static uint32_t HTTP_path_clock;
+
+// Discord rate limits each route and major parameter separately, only touched by the HTTP task
+typedef struct http_bucket {
+    const char *route;
+    uint64_t major;
+    int remaining;    // requests left until the bucket resets
+    int64_t reset_ms; // when the bucket resets, 0 if it was never limited
+    uint32_t last_used;
+} http_bucket_t;
+
+static http_bucket_t HTTP_buckets[HTTP_BUCKET_COUNT];
+static uint32_t HTTP_bucket_clock;
+static int64_t HTTP_global_reset_ms; // a global limit holds back every bucket
+
+// Rate limit headers of the last response
+static int http_limit_remaining;
+static int64_t http_limit_reset_after_ms;
+static int64_t http_retry_after_ms;
+static bool http_limit_global;
+
+static inline int64_t http_now_ms() {
+    return esp_timer_get_time() / 1000;
 }
 
-void http_rest_post_task(void *pvParameters) {
-    for (;;) {
-        ESP_LOGI(HTTP_TAG, "Waiting for queue");
+// len does not count the terminator, the body starts out with one reference that belongs to the caller
+extern http_shared_body_t *http_shared_body_new(size_t len) {
+    http_shared_body_t *body = malloc(sizeof(http_shared_body_t) + len + 1);
+    if (body != NULL) {
+        body->refs = 1;
+        body->len = len;
+        body->data[len] = '\0';
+    }
+    return body;
+}
+
+static inline http_shared_body_t *http_shared_body_retain(http_shared_body_t *body) {
+    __atomic_add_fetch(&body->refs, 1, __ATOMIC_RELAXED);
+    return body;
+}
+
+extern void http_shared_body_release(http_shared_body_t *body) {
+    if (body != NULL && __atomic_sub_fetch(&body->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        free(body);
+    }
+}
+
+static inline void clean_request(http_request_t *request) {
+    free(request->path);
+    free(request->body);
+    http_shared_body_release(request->shared);
+}
+
+// Get the formatted path of a request, formatting it over the least recently used entry on a miss
+static const char *http_request_path(const http_request_t *request) {
+    http_path_entry_t *lru = &HTTP_path_cache[0];
+    HTTP_path_clock++;
+    for (int i = 0; i < HTTP_PATH_CACHE_SIZE; i++) {
+        http_path_entry_t *entry = &HTTP_path_cache[i];
+        if (entry->last_used != 0 && entry->route == request->route && entry->major == request->major && entry->minor == request->minor) {
+            entry->last_used = HTTP_path_clock;
+            return entry->path;
+        }
+        if (entry->last_used < lru->last_used) {
+            lru = entry;
+        }
+    }
+    lru->route = request->route;
+    lru->major = request->major;
+    lru->minor = request->minor;
+    char major[HTTP_ID_LENGTH] = "", minor[HTTP_ID_LENGTH] = ""; // ids only become text here
+    major[string_from_u64(major, request->major)] = '\0';
+    if (request->minor != 0) {
+        minor[string_from_u64(minor, request->minor)] = '\0';
+    }
+    snprintf(lru->path, HTTP_MAX_PATH, request->route, major, minor);
+    lru->last_used = HTTP_path_clock;
+    return lru->path;
+}
+
+static http_bucket_t *http_request_bucket(const http_request_t *request) {
+    http_bucket_t *lru = &HTTP_buckets[0];
+    HTTP_bucket_clock++;
+    for (int i = 0; i < HTTP_BUCKET_COUNT; i++) {
+        http_bucket_t *bucket = &HTTP_buckets[i];
+        if (bucket->last_used != 0 && bucket->route == request->route && bucket->major == request->major) {
+            bucket->last_used = HTTP_bucket_clock;
+            return bucket;
+        }
+        if (bucket->last_used < lru->last_used) {
+            lru = bucket;
+        }
+    }
+    lru->route = request->route;
+    lru->major = request->major;
+    lru->remaining = 1;
+    lru->reset_ms = 0;
+    lru->last_used = HTTP_bucket_clock;
+    return lru;
+}
+
+// How long a request on this bucket has to wait before it may be sent
+static int64_t http_bucket_wait(const http_bucket_t *bucket) {
+    int64_t now = http_now_ms();
+    int64_t reset = HTTP_global_reset_ms;
+    if (bucket->remaining <= 0 && bucket->reset_ms > reset) {
+        reset = bucket->reset_ms;
+    }
+    return reset > now ? reset - now : 0;
+}
+
+static void http_bucket_update(http_bucket_t *bucket, int status) {
+    int64_t now = http_now_ms();
+    if (http_limit_remaining >= 0) {
+        bucket->remaining = http_limit_remaining;
+        bucket->reset_ms = now + http_limit_reset_after_ms;
+    }
+    if (status == 429) {
+        if (http_limit_global) {
+            HTTP_global_reset_ms = now + http_retry_after_ms;
+        } else {
+            bucket->remaining = 0;
+            bucket->reset_ms = now + http_retry_after_ms;
+        }
+    }
+}
+
+static void http_rate_limit_header(const char *key, const char *value) {
+    if (strcasecmp(key, "X-RateLimit-Remaining") == 0) {
+        http_limit_remaining = atoi(value);
+    } else if (strcasecmp(key, "X-RateLimit-Reset-After") == 0) {
+        http_limit_reset_after_ms = strtod(value, NULL) * 1000;
+    } else if (strcasecmp(key, "Retry-After") == 0) {
+        http_retry_after_ms = strtod(value, NULL) * 1000;
+    } else if (strcasecmp(key, "X-RateLimit-Global") == 0) {
+        http_limit_global = strcasecmp(value, "true") == 0;
+    }
+}
+
+// Put a request back in the queue from the HTTP task, it still holds its slot so there is always room
+static bool http_requeue(http_request_t *request, bool front) {
+    BaseType_t queued = front ? xQueueSendToFront(HTTP_POST_Queue, request, 0) : xQueueSendToBack(HTTP_POST_Queue, request, 0);
+    return queued == pdPASS;
+}
+
+// Requests that never reach the HTTP task still complete, so callbacks can free their context
+static void http_discard_request(http_request_t *request) {
+    if (request->on_complete != NULL) {
+        request->on_complete(-1, NULL, 0, request->ctx);
+    }
+    clean_request(request);
+}
+
+static const char *http_method_name(esp_http_client_method_t method) {
+    switch (method) {
+    case HTTP_METHOD_GET:
+        return "GET";
+    case HTTP_METHOD_POST:
+        return "POST";
+    case HTTP_METHOD_PATCH:
+        return "PATCH";
+    case HTTP_METHOD_DELETE:
+        return "DELETE";
+    default:
+        return "?";
+    }
+}
 
-        http_post_data_t postData;
-        xQueueReceive(HTTP_POST_Queue, &postData, portMAX_DELAY); // Wait for new message in queue
-        ESP_LOGI(HTTP_TAG, "Payload received");
+static esp_err_t http_event_handler(esp_http_client_event_t *evt) {
+    switch (evt->event_id) {
+    case HTTP_EVENT_ON_CONNECTED:
+        http_connected = true;
+        local_response_len = 0;
+        break;
+    case HTTP_EVENT_DISCONNECTED:
+        http_connected = false;
+        break;
+    case HTTP_EVENT_ON_HEADER:
+        http_rate_limit_header(evt->header_key, evt->header_value);
+        break;
+    case HTTP_EVENT_ON_DATA: { // Keep as much of the response as fits, the rest is dropped
+        int len = evt->data_len;
+        if (local_response_len + len > HTTP_MAX_BUFFER - 1) {
+            len = HTTP_MAX_BUFFER - 1 - local_response_len;
+        }
+        if (len > 0) {
+            memcpy(local_response_buffer + local_response_len, evt->data, len);
+            local_response_len += len;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    return ESP_OK;
+}
 
-        esp_http_client_config_t config = {
-            .host = HTTP_HOST,
-            .path = postData.path,
-            .user_data = local_response_buffer, // Pass address of local buffer to get response
-        };
+static bool http_count_chunk(const char *data, size_t len, void *ctx) {
+    *(size_t *)ctx += len;
+    return true;
+}
 
-        esp_http_client_handle_t client = esp_http_client_init(&config);
+static bool http_write_chunk(const char *data, size_t len, void *ctx) {
+    esp_http_client_handle_t client = ctx;
+    while (len > 0) {
+        int written = esp_http_client_write(client, data, len);
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        len -= written;
+    }
+    return true;
+}
 
-        ESP_LOGI(HTTP_TAG, "Delaying message");
-        vTaskDelay(pdMS_TO_TICKS(550));
+// Write the body chunk by chunk instead of handing perform one string, the event handler still collects the response
+static esp_err_t http_perform_stream(esp_http_client_handle_t client, const http_request_t *request) {
+    size_t len = 0;
+    if (!request->serialize(request->body, HTTP_stream_buffer, HTTP_STREAM_BUFFER, http_count_chunk, &len)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = esp_http_client_open(client, len);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (!request->serialize(request->body, HTTP_stream_buffer, HTTP_STREAM_BUFFER, http_write_chunk, client) ||
+        esp_http_client_fetch_headers(client) < 0) {
+        return ESP_FAIL;
+    }
+    int read;
+    while ((read = esp_http_client_read(client, HTTP_stream_buffer, HTTP_STREAM_BUFFER)) > 0) // read it all so the connection can be reused
+        ;
+    return read < 0 ? ESP_FAIL : ESP_OK;
+}
+
+void http_rest_task(void *pvParameters) {
+    // One client for the life of the task, so the connection and static headers are reused between requests
+    esp_http_client_config_t config = {
+        .host = HTTP_HOST,
+        .path = "/",
+        .event_handler = http_event_handler,
+        .user_data = local_response_buffer, // Pass address of local buffer to get response
+    };
+    tls_shared_http_config(&config);
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    esp_http_client_set_header(client, "Content-Type", "application/json");
+    esp_http_client_set_header(client, "Authorization", authHeader);
+
+    UBaseType_t deferred = 0; // requests in a row that were moved back for another bucket
+    for (;;) {
+        ESP_LOGI(HTTP_TAG, "Waiting for queue");
+
+        http_request_t request;
+        xQueueReceive(HTTP_POST_Queue, &request, portMAX_DELAY); // Wait for new message in queue
+        ESP_LOGI(HTTP_TAG, "Request received");
 
-        // POST
-        esp_http_client_set_method(client, HTTP_METHOD_POST);
-        esp_http_client_set_header(client, "Content-Type", "application/json");
-        esp_http_client_set_header(client, "Authorization", authHeader);
-        esp_http_client_set_post_field(client, postData.jsonContent, strlen(postData.jsonContent));
+        http_bucket_t *bucket = http_request_bucket(&request);
+        int64_t wait = http_bucket_wait(bucket);
+        if (wait > 0) {
+            // Let requests on other buckets go first, until every waiting request has been looked at
+            if (deferred < uxQueueMessagesWaiting(HTTP_POST_Queue) && http_requeue(&request, false)) {
+                deferred++;
+                continue;
+            }
+            ESP_LOGI(HTTP_TAG, "Rate limited, delaying message %d ms", (int)wait);
+            vTaskDelay(pdMS_TO_TICKS(wait));
+        }
+        deferred = 0;
+
+        local_response_len = 0;
+        http_limit_remaining = -1;
+        http_limit_global = false;
+        http_retry_after_ms = 1000;
+        esp_http_client_set_url(client, request.path != NULL ? request.path : http_request_path(&request));
+        esp_http_client_set_method(client, request.method);
+        if (request.shared != NULL) { // the client only keeps the pointer, nothing is copied
+            esp_http_client_set_post_field(client, request.shared->data, request.shared->len);
+        } else if (request.serialize == NULL) {
+            esp_http_client_set_post_field(client, request.body, request.body != NULL ? strlen(request.body) : 0);
+        }
         ESP_LOGI(HTTP_TAG, "Waiting for HTTP Client");
-        esp_err_t err = esp_http_client_perform(client);
+        int status = -1;
+        bool handshake = !http_connected; // perform will have to connect first
+        if (handshake) {
+            tls_handshake_begin();
+        }
+        if (request.no_auth) { // webhooks must never see the bot token
+            esp_http_client_delete_header(client, "Authorization");
+        }
+        trace_point(TRACE_HTTP_START, request.trace_id);
+        esp_err_t err = request.serialize != NULL ? http_perform_stream(client, &request) : esp_http_client_perform(client);
+        trace_point(TRACE_HTTP_DONE, request.trace_id);
+        if (request.no_auth) {
+            esp_http_client_set_header(client, "Authorization", authHeader);
+        }
+        if (handshake) {
+            tls_handshake_end();
+        }
         if (err == ESP_OK) {
-            int len = esp_http_client_get_content_length(client);
-            ESP_LOGI(HTTP_TAG, "HTTP POST Status = %d, content_length = %d",
-                     esp_http_client_get_status_code(client),
-                     len);
-            if (len > 0) {
-                char *response = malloc(len);
-                esp_http_client_read_response(client, response, len);
-                ESP_LOGI(HTTP_TAG, "Received=%.*s", len, response);
-                free(response);
-            }
+            status = esp_http_client_get_status_code(client);
+            local_response_buffer[local_response_len] = '\0';
+            ESP_LOGI(HTTP_TAG, "HTTP %s Status = %d, content_length = %d", http_method_name(request.method), status, local_response_len);
+            ESP_LOGD(HTTP_TAG, "Received=%.*s", local_response_len, local_response_buffer);
         } else {
-            ESP_LOGE(HTTP_TAG, "HTTP POST request failed: %s", esp_err_to_name(err));
+            local_response_len = 0;
+            ESP_LOGE(HTTP_TAG, "HTTP %s request failed: %s", http_method_name(request.method), esp_err_to_name(err));
+            esp_http_client_close(client); // Reconnect on the next request
+            http_connected = false;
         }
 
-        esp_http_client_cleanup(client);
-        clean_post_data(&postData);
+        http_bucket_update(bucket, status);
+        if (status == 429 && request.retries < HTTP_MAX_RETRIES) {
+            ESP_LOGW(HTTP_TAG, "Rate limited by discord%s, retrying in %d ms", http_limit_global ? " globally" : "", (int)http_retry_after_ms);
+            request.retries++;
+            if (http_requeue(&request, true)) {
+                continue;
+            }
+        }
+
+        xSemaphoreGive(HTTP_queue_slots); // done with the queue, a request the callback sends may take the slot
+        if (request.on_complete != NULL) {
+            trace_set_current(request.trace_id); // a command resumed from here keeps its message
+            request.on_complete(status, local_response_buffer, local_response_len, request.ctx);
+            trace_set_current(0);
+        }
+
+        clean_request(&request);
     }
+    esp_http_client_cleanup(client);
     vTaskDelete(NULL);
 }
 
-extern void http_queue_message(http_post_data_t *postData) {
-    ESP_LOGI(HTTP_TAG, "Queuing message: %s", postData->jsonContent);
-    xQueueSendToBack(HTTP_POST_Queue, postData, 0);
+#ifdef CONFIG_HTTP_QUEUE_DROP_OLDEST
+// Evict the oldest queued request if it is low priority and hand its slot to the caller
+// Only the HTTP task can remove entries concurrently, a request it takes keeps its slot until it is done
+static bool http_drop_oldest() {
+    http_request_t oldest;
+    if (xQueueReceive(HTTP_POST_Queue, &oldest, 0) != pdPASS) {
+        return false; // the HTTP task has them all, its slots come back as it finishes
+    }
+    if (oldest.priority != HTTP_PRIORITY_LOW) {
+        xQueueSendToFront(HTTP_POST_Queue, &oldest, 0); // the slot we freed is still ours
+        return false;
+    }
+    ESP_LOGW(HTTP_TAG, "Queue full, dropping oldest low priority %s request", http_method_name(oldest.method));
+    HTTP_queue_stats.dropped++;
+    http_discard_request(&oldest);
+    return true;
+}
+#endif
+
+// Takes ownership of the request strings, they are freed if the request is rejected
+extern esp_err_t http_queue_message(http_request_t *request) {
+    ESP_LOGI(HTTP_TAG, "Queuing %s request: %s", http_method_name(request->method),
+             request->shared != NULL                              ? request->shared->data
+             : request->body != NULL && request->serialize == NULL ? request->body
+                                                                   : "");
+    request->trace_id = trace_current();
+    uint32_t queued_us = trace_now(); // before the HTTP task can take it
+
+    // Slots are never more than the queue holds, so a request with one is sent without waiting
+    xSemaphoreTake(HTTP_admission_lock, portMAX_DELAY);
+    BaseType_t slot = xSemaphoreTake(HTTP_queue_slots, 0);
+#ifdef CONFIG_HTTP_QUEUE_DROP_OLDEST
+    if (slot != pdPASS && http_drop_oldest()) {
+        slot = pdPASS;
+    }
+#endif
+    xSemaphoreGive(HTTP_admission_lock);
+    if (slot != pdPASS && HTTP_QUEUE_TIMEOUT > 0) {
+        slot = xSemaphoreTake(HTTP_queue_slots, pdMS_TO_TICKS(HTTP_QUEUE_TIMEOUT));
+    }
+    BaseType_t queued = slot == pdPASS ? xQueueSendToBack(HTTP_POST_Queue, request, 0) : pdFAIL;
+    if (slot == pdPASS && queued != pdPASS) {
+        xSemaphoreGive(HTTP_queue_slots);
+    }
+
+    xSemaphoreTake(HTTP_admission_lock, portMAX_DELAY);
+    if (queued == pdPASS) {
+        trace_at(TRACE_HTTP_QUEUED, request->trace_id, queued_us);
+        HTTP_queue_stats.queued++;
+        uint32_t waiting = uxQueueMessagesWaiting(HTTP_POST_Queue);
+        if (waiting > HTTP_queue_stats.high_water) {
+            HTTP_queue_stats.high_water = waiting;
+        }
+    } else {
+        HTTP_queue_stats.rejected++;
+    }
+    xSemaphoreGive(HTTP_admission_lock);
+
+    if (queued != pdPASS) {
+        ESP_LOGE(HTTP_TAG, "Queue full, rejected %s request (%u rejected so far)", http_method_name(request->method), HTTP_queue_stats.rejected);
+        http_discard_request(request);
+        return ESP_ERR_TIMEOUT;
+    }
+    return ESP_OK;
+}
+
+extern void http_get_queue_stats(http_queue_stats_t *stats) {
+    xSemaphoreTake(HTTP_admission_lock, portMAX_DELAY);
+    *stats = HTTP_queue_stats;
+    xSemaphoreGive(HTTP_admission_lock);
 }
 
 extern esp_err_t http_init(const char *authHeaderStr) {
     authHeader = authHeaderStr;
-    ESP_LOGI(HTTP_TAG, "Creating HTTP POST Queue");
-    HTTP_POST_Queue = xQueueCreate(HTTP_MAX_QUEUE, sizeof(struct http_post_data)); // strings should be allocated then freed
-    if (HTTP_POST_Queue == NULL) {
+    local_response_buffer = mem_place_alloc("http response", HTTP_MAX_BUFFER, MEM_BULK);
+    if (local_response_buffer == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(HTTP_TAG, "Creating HTTP request Queue");
+    HTTP_POST_Queue = xQueueCreate(HTTP_MAX_QUEUE, sizeof(struct http_request)); // strings should be allocated then freed
+    HTTP_admission_lock = xSemaphoreCreateMutex();
+    HTTP_queue_slots = xSemaphoreCreateCounting(HTTP_MAX_QUEUE, HTTP_MAX_QUEUE);
+    if (HTTP_POST_Queue == NULL || HTTP_admission_lock == NULL || HTTP_queue_slots == NULL) {
         ESP_LOGE(HTTP_TAG, "Failed to create queue");
         return ESP_FAIL;
     }
-    if (xTaskCreate(http_rest_post_task, "HTTP POST", 4096, NULL, 16, NULL) != pdPASS) {
+    if (xTaskCreate(http_rest_task, "HTTP REST", 4096, NULL, 16, NULL) != pdPASS) {
         ESP_LOGE(HTTP_TAG, "Failed to start HTTP task");
         return ESP_FAIL;
     }
 
     return ESP_OK;
-}
\ No newline at end of file
+}
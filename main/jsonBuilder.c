@@ -1,105 +1,246 @@
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-static const char JSON_Key[] = "\"%s\":";
-static const char JSON_String[] = "\"%s\"";
-static const char *JSON_Array_Open = "[";
-static const char *JSON_Array_Close = "]";
-static const char *JSON_List_Open = "{";
-static const char *JSON_List_Close = "}";
-static const char *JSON_Comma = ",";
+#include "jsonEscape.h"
+#include "jsonTemplate.h"
 
-// IMPROVE: should these string functions accept buffers instead?
+#define JSON_MAX_DEPTH 16
+#define JSON_MIN_CAPACITY 64
+#define JSON_MIN_STREAM_BUFFER (JSON_ESCAPE_UNIT_MAX + 2) // an escaped character and the terminator always fit
 
-// Append string by redefining string pointer
-static inline void str_append(char **string, const char *append) {
-    char *new_str = calloc(1, strlen(*string) + strlen(append) + 1);
-    strcat(new_str, *string);
-    strcat(new_str, append);
-    free(*string);
-    *string = new_str;
+// Hands off a full buffer of a streamed object, returns false to stop building
+typedef bool (*json_flush_handler)(const char *data, size_t len, void *ctx);
+
+// Everything is appended into one buffer, either the caller's or a heap buffer that doubles when full
+// A streamed object reuses a small buffer, flushing it whenever it is full
+typedef struct json_object {
+    char *string;
+    size_t len;
+    size_t cap;
+    size_t flushed;                 // bytes already handed to flush
+    json_flush_handler flush;       // NULL unless the object is streamed
+    void *flush_ctx;
+    bool growable;                  // string is owned and may be reallocated
+    bool failed;                    // ran out of room or nesting, json_finish returns NULL
+    bool after_key;                 // next item is the value of a key, it needs no comma
+    uint8_t depth;
+    bool has_item[JSON_MAX_DEPTH];  // whether the open list or array at each depth needs a comma before its next item
+} json_object_t;
+
+typedef struct json_str {
+    char *ptr; // NULL if building failed
+    size_t len;
+} json_str_t;
+
+static void json_flush(json_object_t *json) {
+    if (!json->flush(json->string, json->len, json->flush_ctx)) {
+        json->failed = true;
+    }
+    json->flushed += json->len;
+    json->len = 0;
 }
 
-// Single parameter string format by redefining string pointer
-static inline void pfstr(char **string, const char *pattern, const char *value) {
-    int len = strlen(pattern) + strlen(value) + 1;
-    char *new_str = calloc(1, len);
-    snprintf(new_str, len, pattern, value);
-    free(*string);
-    *string = new_str;
+// Make room for len more bytes plus a terminator
+static bool json_reserve(json_object_t *json, size_t len) {
+    if (json->failed) {
+        return false;
+    }
+    if (json->len + len + 1 <= json->cap) {
+        return true;
+    }
+    if (json->flush != NULL) {
+        json_flush(json);
+        if (json->len + len + 1 > json->cap) {
+            json->failed = true;
+        }
+        return !json->failed;
+    }
+    if (!json->growable) {
+        json->failed = true;
+        return false;
+    }
+    size_t cap = json->cap * 2;
+    while (cap < json->len + len + 1) {
+        cap *= 2;
+    }
+    char *string = realloc(json->string, cap);
+    if (string == NULL) {
+        json->failed = true;
+        return false;
+    }
+    json->string = string;
+    json->cap = cap;
+    return true;
 }
 
-// Append a single parameter formatted string by redefining string pointer
-static inline void pfstr_append(char **string, const char *pattern, const char *value) {
-    char *pf_str = malloc(0);
-    pfstr(&pf_str, pattern, value);
-    str_append(string, pf_str);
-    free(pf_str);
+static inline void json_write(json_object_t *json, const char *data, size_t len) {
+    while (json->flush != NULL && !json->failed && json->len + len + 1 > json->cap) { // a streamed write may span buffers
+        size_t part = json->cap - 1 - json->len;
+        memcpy(json->string + json->len, data, part);
+        json->len += part;
+        data += part;
+        len -= part;
+        json_flush(json);
+    }
+    if (json_reserve(json, len)) {
+        memcpy(json->string + json->len, data, len);
+        json->len += len;
+    }
 }
 
-typedef struct json_object {
-    char *string;
-    // bool expecting_key; // IMPROVE: error checking json building
-    // bool expecting_value;
-    // bool finished;
-    unsigned int addComma; // massive jsons would have issues but idc
-} json_object_t;
+static inline void json_write_char(json_object_t *json, char c) {
+    if (json_reserve(json, 1)) {
+        json->string[json->len++] = c;
+    }
+}
+
+// Separate this item from the previous one at the same depth
+static void json_item(json_object_t *json) {
+    if (json->after_key) {
+        json->after_key = false;
+    } else if (json->has_item[json->depth]) {
+        json_write_char(json, ',');
+    }
+    json->has_item[json->depth] = true;
+}
+
+static void json_open(json_object_t *json, char c) {
+    json_item(json);
+    json_write_char(json, c);
+    if (json->depth + 1 >= JSON_MAX_DEPTH) {
+        json->failed = true;
+        return;
+    }
+    json->has_item[++json->depth] = false;
+}
+
+static void json_close(json_object_t *json, char c) {
+    if (json->depth > 0) {
+        json->depth--;
+    }
+    json_write_char(json, c);
+}
+
+// Build into a caller supplied buffer, nothing is allocated and building fails if it runs out of room
+extern json_object_t json_init_buffer(char *buffer, size_t size) {
+    json_object_t obj = {
+        .string = buffer,
+        .cap = size,
+    };
+    json_write_char(&obj, '{'); // Start Json
+    return obj;
+}
+
+// Build into a heap buffer, a good capacity estimate means a single allocation
+extern json_object_t json_init_capacity(size_t capacity) {
+    if (capacity < JSON_MIN_CAPACITY) {
+        capacity = JSON_MIN_CAPACITY;
+    }
+    char *buffer = malloc(capacity);
+    if (buffer == NULL) {
+        json_object_t obj = {.failed = true};
+        return obj;
+    }
+    json_object_t obj = json_init_buffer(buffer, capacity);
+    obj.growable = true;
+    return obj;
+}
 
 extern json_object_t json_init() {
+    return json_init_capacity(JSON_MIN_CAPACITY);
+}
+
+// Stream the object through flush, the buffer only has to hold a few characters
+extern json_object_t json_init_stream(char *buffer, size_t size, json_flush_handler flush, void *ctx) {
     json_object_t obj = {
-        .string = strdup(JSON_List_Open), // Start Json
-        // .expecting_key = true,
-        // .expecting_value = false,
-        // .finished = false,
-        .addComma = 0,
+        .string = buffer,
+        .cap = size,
+        .flush = flush,
+        .flush_ctx = ctx,
+        .failed = size < JSON_MIN_STREAM_BUFFER,
     };
+    json_write_char(&obj, '{'); // Start Json
     return obj;
 }
 
-extern char *json_finish(json_object_t *json) {
-    str_append(&json->string, JSON_List_Close);
-    // json->finished = false;
-    return json->string;
+// Close the top level object and terminate the string, a heap buffer is freed if building failed
+// A streamed object flushes what is left, its length is the total that was flushed
+extern json_str_t json_finish(json_object_t *json) {
+    json_write_char(json, '}');
+    if (json->flush != NULL && !json->failed) {
+        json_flush(json);
+    }
+    json_str_t str = {NULL, 0};
+    if (json->failed) {
+        if (json->growable) {
+            free(json->string);
+        }
+        return str;
+    }
+    json->string[json->len] = '\0';
+    str.ptr = json->string;
+    str.len = json->flushed + json->len;
+    return str;
 }
 
 extern void json_open_array(json_object_t *json) {
-    json->addComma <<= 1;
-    str_append(&json->string, JSON_Array_Open);
+    json_open(json, '[');
 }
 
 extern void json_close_array(json_object_t *json) {
-    json->addComma >>= 1;
-    str_append(&json->string, JSON_Array_Close);
+    json_close(json, ']');
 }
 
 extern void json_open_list(json_object_t *json) {
-    json->addComma <<= 1;
-    str_append(&json->string, JSON_List_Open);
+    json_open(json, '{');
 }
 
 extern void json_close_list(json_object_t *json) {
-    json->addComma >>= 1;
-    str_append(&json->string, JSON_List_Close);
+    json_close(json, '}');
 }
 
-extern void json_value(json_object_t *json, const char *key) {
-    str_append(&json->string, key);
+// Raw value, such as a number or literal, that is written as is
+extern void json_value(json_object_t *json, const char *value) {
+    json_item(json);
+    json_write(json, value, strlen(value));
 }
 
-extern void json_string(json_object_t *json, const char *key) {
-    int len = strlen(JSON_String) + strlen(key) + 1;
-    char *str = calloc(1, len);
-    snprintf(str, len, JSON_String, key);
-    json_value(json, str);
-    free(str);
+extern void json_int(json_object_t *json, long value) {
+    json_item(json);
+    if (json_reserve(json, json_int_digits(value))) {
+        json->len += json_int_write(json->string + json->len, value);
+    }
 }
 
-extern void json_key(json_object_t *json, const char *key) {
-    if (json->addComma & 1) {
-        str_append(&json->string, JSON_Comma);
-    } else {
-        json->addComma |= 1;
+// Clean runs are copied in bulk, only the characters between them are escaped one at a time
+extern void json_string(json_object_t *json, const char *value) {
+    size_t len = strlen(value);
+    json_item(json);
+    json_write_char(json, '"');
+    while (len > 0) {
+        size_t run = json_clean_run(value, len);
+        json_write(json, value, run);
+        value += run;
+        len -= run;
+        if (len > 0 && json_reserve(json, JSON_ESCAPE_UNIT_MAX)) {
+            size_t used;
+            json->len += json_escape_unit(value, len, json->string + json->len, &used);
+            value += used;
+            len -= used;
+        } else if (len > 0) {
+            return; // failed, nothing more can be written
+        }
     }
-    pfstr_append(&json->string, JSON_Key, key);
-}
\ No newline at end of file
+    json_write_char(json, '"');
+}
+
+extern void json_key(json_object_t *json, const char *key) {
+    json_item(json);
+    json_write_char(json, '"');
+    json_write(json, key, strlen(key));
+    json_write(json, "\":", 2);
+    json->after_key = true;
+}
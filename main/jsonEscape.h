@@ -0,0 +1,264 @@
+#ifndef __JSON_ESCAPE_H__
+#define __JSON_ESCAPE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// Escaping works on native words, 4 bytes on the ESP32
+typedef uintptr_t json_word_t;
+
+#define JSON_ESCAPE_UNIT_MAX 6 // longest output of one escaped character, \uXXXX
+#define JSON_WORD_BYTES(b) ((json_word_t)-1 / 0xFF * (b))
+
+static const char JSON_HEX[] = "0123456789abcdef";
+
+// Whether any byte in the word is zero, (x - 1) only borrows into the high bit for a zero byte
+static inline json_word_t json_word_has_zero(json_word_t w) {
+    return (w - JSON_WORD_BYTES(0x01)) & ~w & JSON_WORD_BYTES(0x80);
+}
+
+// Whether any byte in the word needs escaping, or is not ascii and has to be checked as UTF-8
+static inline json_word_t json_word_needs_escape(json_word_t w) {
+    json_word_t control = (w - JSON_WORD_BYTES(0x20)) & ~w; // bytes below 0x20
+    json_word_t quote = json_word_has_zero(w ^ JSON_WORD_BYTES('"'));
+    json_word_t slash = json_word_has_zero(w ^ JSON_WORD_BYTES('\\'));
+    return ((control | w) & JSON_WORD_BYTES(0x80)) | quote | slash;
+}
+
+static inline bool json_byte_needs_escape(unsigned char c) {
+    return c < 0x20 || c == '"' || c == '\\' || c >= 0x80;
+}
+
+// Length of the leading run of bytes that can be copied into a json string as is
+static size_t json_clean_run(const char *value, size_t len) {
+    size_t i = 0;
+    while (i + sizeof(json_word_t) <= len) {
+        json_word_t w;
+        memcpy(&w, value + i, sizeof(json_word_t)); // the string may not be aligned
+        if (json_word_needs_escape(w)) {
+            break;
+        }
+        i += sizeof(json_word_t);
+    }
+    while (i < len && !json_byte_needs_escape(value[i])) {
+        i++;
+    }
+    return i;
+}
+
+// Length of the valid UTF-8 sequence at the start of value, 0 if it is not valid
+static size_t json_utf8_length(const unsigned char *value, size_t len) {
+    size_t n;
+    uint32_t min;
+    if (value[0] >= 0xC2 && value[0] <= 0xDF) {
+        n = 2, min = 0x80;
+    } else if ((value[0] & 0xF0) == 0xE0) {
+        n = 3, min = 0x800;
+    } else if (value[0] >= 0xF0 && value[0] <= 0xF4) {
+        n = 4, min = 0x10000;
+    } else {
+        return 0;
+    }
+    if (n > len) {
+        return 0;
+    }
+    uint32_t code = value[0] & (0x3F >> (n - 1));
+    for (size_t i = 1; i < n; i++) {
+        if ((value[i] & 0xC0) != 0x80) {
+            return 0;
+        }
+        code = (code << 6) | (value[i] & 0x3F);
+    }
+    if (code < min || code > 0x10FFFF || (code >= 0xD800 && code <= 0xDFFF)) {
+        return 0; // overlong, out of range or a surrogate
+    }
+    return n;
+}
+
+// Escape the character at the start of value that json_clean_run stopped at
+// Invalid UTF-8 becomes U+FFFD, returns the output length and sets how much of value was used
+static size_t json_escape_unit(const char *value, size_t len, char *out, size_t *used) {
+    unsigned char c = value[0];
+    *used = 1;
+    if (c >= 0x80) {
+        size_t n = json_utf8_length((const unsigned char *)value, len);
+        if (n == 0) {
+            memcpy(out, "\\ufffd", 6);
+            return 6;
+        }
+        memcpy(out, value, n);
+        *used = n;
+        return n;
+    }
+    out[0] = '\\';
+    switch (c) {
+    case '"':
+    case '\\':
+        out[1] = c;
+        return 2;
+    case '\n':
+        out[1] = 'n';
+        return 2;
+    case '\r':
+        out[1] = 'r';
+        return 2;
+    case '\t':
+        out[1] = 't';
+        return 2;
+    case '\b':
+        out[1] = 'b';
+        return 2;
+    case '\f':
+        out[1] = 'f';
+        return 2;
+    default:
+        memcpy(out + 1, "u00", 3);
+        out[4] = JSON_HEX[c >> 4];
+        out[5] = JSON_HEX[c & 0xF];
+        return 6;
+    }
+}
+
+// Length of value once escaped, without the quotes
+static size_t json_escaped_length(const char *value, size_t len) {
+    size_t total = 0;
+    char unit[JSON_ESCAPE_UNIT_MAX];
+    while (len > 0) {
+        size_t run = json_clean_run(value, len);
+        total += run;
+        value += run;
+        len -= run;
+        if (len > 0) {
+            size_t used;
+            total += json_escape_unit(value, len, unit, &used);
+            value += used;
+            len -= used;
+        }
+    }
+    return total;
+}
+
+// Escape value into out, which must hold json_escaped_length bytes, returns the bytes written
+static size_t json_escape(char *out, const char *value, size_t len) {
+    char *start = out;
+    while (len > 0) {
+        size_t run = json_clean_run(value, len);
+        memcpy(out, value, run);
+        out += run;
+        value += run;
+        len -= run;
+        if (len > 0) {
+            size_t used;
+            out += json_escape_unit(value, len, out, &used);
+            value += used;
+            len -= used;
+        }
+    }
+    return out - start;
+}
+
+static int json_hex_value(const char *hex) {
+    int value = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = hex[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9') {
+            value |= c - '0';
+        } else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+            value |= (c | 0x20) - 'a' + 10;
+        } else {
+            return -1;
+        }
+    }
+    return value;
+}
+
+static size_t json_utf8_encode(char *out, uint32_t code) {
+    if (code < 0x80) {
+        out[0] = code;
+        return 1;
+    } else if (code < 0x800) {
+        out[0] = 0xC0 | (code >> 6);
+        out[1] = 0x80 | (code & 0x3F);
+        return 2;
+    } else if (code < 0x10000) {
+        out[0] = 0xE0 | (code >> 12);
+        out[1] = 0x80 | ((code >> 6) & 0x3F);
+        out[2] = 0x80 | (code & 0x3F);
+        return 3;
+    }
+    out[0] = 0xF0 | (code >> 18);
+    out[1] = 0x80 | ((code >> 12) & 0x3F);
+    out[2] = 0x80 | ((code >> 6) & 0x3F);
+    out[3] = 0x80 | (code & 0x3F);
+    return 4;
+}
+
+// Unescape a json string in place, an escape is never shorter than what it stands for
+// The string needs room for a terminator, returns the new length
+static size_t json_unescape(char *string, size_t len) {
+    char *end = string + len;
+    char *in = memchr(string, '\\', len);
+    if (in == NULL) {
+        string[len] = '\0';
+        return len;
+    }
+    char *out = in;
+    while (in < end) {
+        char *slash = memchr(in, '\\', end - in);
+        size_t run = (slash != NULL ? slash : end) - in;
+        memmove(out, in, run);
+        out += run;
+        in += run;
+        if (in + 1 >= end) {
+            break; // no escape, or a lone trailing backslash that is dropped
+        }
+        char c = in[1];
+        in += 2;
+        switch (c) {
+        case 'n':
+            *out++ = '\n';
+            break;
+        case 'r':
+            *out++ = '\r';
+            break;
+        case 't':
+            *out++ = '\t';
+            break;
+        case 'b':
+            *out++ = '\b';
+            break;
+        case 'f':
+            *out++ = '\f';
+            break;
+        case 'u': {
+            int code = end - in >= 4 ? json_hex_value(in) : -1;
+            if (code < 0) {
+                break; // malformed, it is dropped since its replacement would not fit in place
+            }
+            in += 4;
+            if (code >= 0xD800 && code <= 0xDBFF) { // high surrogate, needs the low half that follows
+                int low = end - in >= 6 && in[0] == '\\' && in[1] == 'u' ? json_hex_value(in + 2) : -1;
+                if (low >= 0xDC00 && low <= 0xDFFF) {
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    in += 6;
+                } else {
+                    code = 0xFFFD;
+                }
+            } else if (code >= 0xDC00 && code <= 0xDFFF) {
+                code = 0xFFFD;
+            }
+            out += json_utf8_encode(out, code);
+            break;
+        }
+        default: // \" \\ \/
+            *out++ = c;
+            break;
+        }
+    }
+    *out = '\0';
+    return out - string;
+}
+
+#endif // __JSON_ESCAPE_H__
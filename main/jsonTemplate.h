@@ -0,0 +1,127 @@
+#ifndef __JSON_TEMPLATE_H__
+#define __JSON_TEMPLATE_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "helper.h"
+#include "jsonEscape.h"
+
+// A template is a static array of segments, the literal lengths are known at compile time
+typedef enum json_segment_type {
+    JSON_SEG_LITERAL,
+    JSON_SLOT_STRING,    // escaped and quoted
+    JSON_SLOT_INT,       // signed integer
+    JSON_SLOT_SNOWFLAKE, // 64 bit id, quoted as discord expects
+    JSON_SLOT_COLOR,     // 24 bit rgb, written as an integer
+    JSON_SLOT_RAW,       // written as is, eg. null or a number that is already formatted
+} json_segment_type_t;
+
+typedef struct json_segment {
+    json_segment_type_t type;
+    uint8_t slot;        // index of the value filling this slot
+    uint16_t len;        // length of the literal
+    const char *literal;
+} json_segment_t;
+
+typedef union json_slot {
+    const char *string;
+    long integer;
+    uint64_t snowflake;
+} json_slot_t;
+
+#define JSON_LITERAL(s) {JSON_SEG_LITERAL, 0, sizeof(s) - 1, s}
+#define JSON_SLOT(type, index) {type, index, 0, NULL}
+#define JSON_TEMPLATE_LENGTH(tpl) (sizeof(tpl) / sizeof((tpl)[0]))
+
+static inline int json_int_digits(long value) {
+    return value < 0 ? 1 + string_u64_digits(-(uint64_t)value) : string_u64_digits(value);
+}
+
+static inline int json_int_write(char *out, long value) {
+    if (value < 0) {
+        *out = '-';
+        return 1 + string_from_u64(out + 1, -(uint64_t)value);
+    }
+    return string_from_u64(out, value);
+}
+
+static inline size_t json_segment_size(const json_segment_t *seg, const json_slot_t *values) {
+    const json_slot_t *value = &values[seg->slot];
+    switch (seg->type) {
+    case JSON_SEG_LITERAL:
+        return seg->len;
+    case JSON_SLOT_STRING:
+        return json_escaped_length(value->string, strlen(value->string)) + 2;
+    case JSON_SLOT_INT:
+    case JSON_SLOT_COLOR:
+        return json_int_digits(value->integer);
+    case JSON_SLOT_SNOWFLAKE:
+        return string_u64_digits(value->snowflake) + 2;
+    case JSON_SLOT_RAW:
+        return strlen(value->string);
+    }
+    return 0;
+}
+
+// Exact length of the rendered template, without a terminator
+static inline size_t json_template_size(const json_segment_t *tpl, size_t count, const json_slot_t *values) {
+    size_t size = 0;
+    for (size_t i = 0; i < count; i++) {
+        size += json_segment_size(&tpl[i], values);
+    }
+    return size;
+}
+
+// Render into out and terminate it, returns the length or -1 if it does not fit in size
+static inline int json_template_render(const json_segment_t *tpl, size_t count, const json_slot_t *values, char *out, size_t size) {
+    if (json_template_size(tpl, count, values) + 1 > size) {
+        return -1;
+    }
+    char *start = out;
+    for (size_t i = 0; i < count; i++) {
+        const json_segment_t *seg = &tpl[i];
+        const json_slot_t *value = &values[seg->slot];
+        switch (seg->type) {
+        case JSON_SEG_LITERAL:
+            memcpy(out, seg->literal, seg->len);
+            out += seg->len;
+            break;
+        case JSON_SLOT_STRING:
+            *out++ = '"';
+            out += json_escape(out, value->string, strlen(value->string));
+            *out++ = '"';
+            break;
+        case JSON_SLOT_INT:
+        case JSON_SLOT_COLOR:
+            out += json_int_write(out, value->integer);
+            break;
+        case JSON_SLOT_SNOWFLAKE:
+            *out++ = '"';
+            out += string_from_u64(out, value->snowflake);
+            *out++ = '"';
+            break;
+        case JSON_SLOT_RAW: {
+            size_t len = strlen(value->string);
+            memcpy(out, value->string, len);
+            out += len;
+            break;
+        }
+        }
+    }
+    *out = '\0';
+    return out - start;
+}
+
+// Render into a heap buffer of exactly the right size
+static inline char *json_template_alloc(const json_segment_t *tpl, size_t count, const json_slot_t *values) {
+    size_t size = json_template_size(tpl, count, values) + 1;
+    char *out = malloc(size);
+    if (out != NULL) {
+        json_template_render(tpl, count, values, out, size);
+    }
+    return out;
+}
+
+#endif // __JSON_TEMPLATE_H__
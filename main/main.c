@@ -13,6 +13,9 @@
 
 #include "nvs_flash.h"
 
+#include "mem_place.h"
+#include "tls_shared.h"
+
 #include "bot.c"
 #include "websocket.c"
 #include "wifi_interface.c"
@@ -38,6 +41,10 @@ void app_main(void) {
     ESP_LOGI(LOG_TAG, "Attempting Wifi connection");
     ESP_ERROR_CHECK(attempt_connect());
 
+    // TLS
+    ESP_LOGI(LOG_TAG, "Initalizing shared TLS");
+    ESP_ERROR_CHECK(tls_shared_init());
+
     // WEBSOCKET INIT
     ESP_LOGI(LOG_TAG, "Initalizing Websocket");
     QueueHandle_t message_queue = websocket_init(); // Get message queue from websocket
@@ -56,4 +63,5 @@ void app_main(void) {
     ESP_ERROR_CHECK(websocket_app_start());
 
     ESP_LOGI(LOG_TAG, "Free memory: %d bytes", esp_get_free_heap_size());
+    mem_place_log();
 }
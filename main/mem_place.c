@@ -0,0 +1,102 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+#include "mem_place.h"
+
+#define MEM_MAP_ENTRIES 16 // buffers past this are still placed, only not listed
+#define MEM_INTERNAL_CAPS (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+#define MEM_PSRAM_CAPS (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+
+static const char MEM_TAG[] = "Memory";
+
+typedef struct mem_map_entry {
+    const char *name;
+    void *ptr; // NULL if the entry is free
+    size_t size;
+    bool psram;
+} mem_map_entry_t;
+
+// Buffers are placed while starting up and freed while shutting down, never from two tasks at once
+static mem_map_entry_t MEM_map[MEM_MAP_ENTRIES];
+
+static void *mem_place_calloc(size_t size, mem_place_t place, bool *psram) {
+#ifdef CONFIG_MEM_BULK_PSRAM
+    if (place == MEM_BULK) {
+        void *ptr = heap_caps_calloc(1, size, MEM_PSRAM_CAPS);
+        if (ptr != NULL) {
+            *psram = true;
+            return ptr;
+        }
+        ESP_LOGW(MEM_TAG, "PSRAM is full, placing %u bytes internally", (unsigned)size);
+    }
+#endif
+    *psram = false;
+    return heap_caps_calloc(1, size, MEM_INTERNAL_CAPS);
+}
+
+extern void *mem_place_alloc(const char *name, size_t size, mem_place_t place) {
+    bool psram;
+    void *ptr = mem_place_calloc(size, place, &psram);
+    if (ptr == NULL) {
+        ESP_LOGE(MEM_TAG, "No room for %s (%u bytes)", name, (unsigned)size);
+        return NULL;
+    }
+    for (int i = 0; i < MEM_MAP_ENTRIES; i++) {
+        if (MEM_map[i].ptr == NULL) {
+            MEM_map[i] = (mem_map_entry_t){.name = name, .ptr = ptr, .size = size, .psram = psram};
+            break;
+        }
+    }
+    return ptr;
+}
+
+extern void mem_place_free(void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+    for (int i = 0; i < MEM_MAP_ENTRIES; i++) {
+        if (MEM_map[i].ptr == ptr) {
+            MEM_map[i].ptr = NULL;
+            break;
+        }
+    }
+    heap_caps_free(ptr);
+}
+
+extern QueueHandle_t mem_place_queue(const char *name, UBaseType_t length, UBaseType_t item_size, mem_place_t place) {
+    StaticQueue_t *control = heap_caps_calloc(1, sizeof(StaticQueue_t), MEM_INTERNAL_CAPS);
+    uint8_t *storage = mem_place_alloc(name, (size_t)length * item_size, place);
+    QueueHandle_t queue = NULL;
+    if (control != NULL && storage != NULL) {
+        queue = xQueueCreateStatic(length, item_size, storage, control);
+    }
+    if (queue == NULL) {
+        heap_caps_free(control);
+        mem_place_free(storage);
+    }
+    return queue;
+}
+
+extern void mem_place_log(void) {
+    size_t placed[2] = {0};
+    ESP_LOGI(MEM_TAG, "Memory map:");
+    for (int i = 0; i < MEM_MAP_ENTRIES; i++) {
+        if (MEM_map[i].ptr != NULL) {
+            ESP_LOGI(MEM_TAG, "  %-16s %6u bytes in %s", MEM_map[i].name, (unsigned)MEM_map[i].size, MEM_map[i].psram ? "PSRAM" : "internal RAM");
+            placed[MEM_map[i].psram] += MEM_map[i].size;
+        }
+    }
+    ESP_LOGI(MEM_TAG, "Internal RAM: %u placed, %u free, %u largest block, %u lowest free", (unsigned)placed[0],
+             (unsigned)heap_caps_get_free_size(MEM_INTERNAL_CAPS), (unsigned)heap_caps_get_largest_free_block(MEM_INTERNAL_CAPS),
+             (unsigned)heap_caps_get_minimum_free_size(MEM_INTERNAL_CAPS));
+#ifdef CONFIG_MEM_BULK_PSRAM
+    ESP_LOGI(MEM_TAG, "PSRAM: %u placed, %u free of %u", (unsigned)placed[1], (unsigned)heap_caps_get_free_size(MEM_PSRAM_CAPS),
+             (unsigned)heap_caps_get_total_size(MEM_PSRAM_CAPS));
+#endif
+}
@@ -0,0 +1,25 @@
+#ifndef __MEM_PLACE_H__
+#define __MEM_PLACE_H__
+
+#include <stddef.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+typedef enum mem_place {
+    MEM_INTERNAL, // internal RAM, for buffers the transport reads while it holds the connection
+    MEM_BULK,     // PSRAM when it is enabled, internal RAM otherwise
+} mem_place_t;
+
+// Zeroed and listed in the memory map under name, NULL if neither place has room
+extern void *mem_place_alloc(const char *name, size_t size, mem_place_t place);
+
+extern void mem_place_free(void *ptr);
+
+// Queue whose item storage is placed, its control block always stays internal
+extern QueueHandle_t mem_place_queue(const char *name, UBaseType_t length, UBaseType_t item_size, mem_place_t place);
+
+// Where every placed buffer went and what is left in each heap
+extern void mem_place_log(void);
+
+#endif // __MEM_PLACE_H__
@@ -0,0 +1,54 @@
+#include "esp_log.h"
+#include "esp_tls.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "tls_shared.h"
+#ifdef CONFIG_TLS_VERIFY_SERVER
+#include "esp_crt_bundle.h"
+#include "esp_transport_ssl.h"
+#endif
+
+static const char TLS_TAG[] = "TLS";
+static SemaphoreHandle_t TLS_handshake_lock;
+
+// Both clients verify against the same certificate bundle, it is only parsed once no matter how many connections use it
+extern esp_err_t tls_shared_init(void) {
+    ESP_LOGI(TLS_TAG, "Initalizing shared TLS setup");
+    TLS_handshake_lock = xSemaphoreCreateMutex();
+    if (TLS_handshake_lock == NULL) {
+        ESP_LOGE(TLS_TAG, "Failed to create handshake lock");
+        return ESP_FAIL;
+    }
+#ifndef CONFIG_TLS_VERIFY_SERVER
+    ESP_LOGW(TLS_TAG, "Server certificates are not verified");
+#endif
+    return ESP_OK;
+}
+
+extern void tls_shared_http_config(esp_http_client_config_t *config) {
+    config->transport_type = HTTP_TRANSPORT_OVER_SSL;
+#ifdef CONFIG_TLS_VERIFY_SERVER
+    config->crt_bundle_attach = esp_crt_bundle_attach;
+#endif
+}
+
+extern void tls_shared_ssl_transport(esp_transport_handle_t ssl) {
+#ifdef CONFIG_TLS_VERIFY_SERVER
+    esp_transport_ssl_crt_bundle_attach(ssl, esp_crt_bundle_attach);
+#endif
+}
+
+// A handshake needs the most heap, so only let one client do it at a time
+extern void tls_handshake_begin(void) {
+#ifdef CONFIG_TLS_SERIALIZE_HANDSHAKES
+    xSemaphoreTake(TLS_handshake_lock, portMAX_DELAY);
+#endif
+}
+
+extern void tls_handshake_end(void) {
+#ifdef CONFIG_TLS_SERIALIZE_HANDSHAKES
+    xSemaphoreGive(TLS_handshake_lock);
+#endif
+}
@@ -0,0 +1,17 @@
+#ifndef __TLS_SHARED_H__
+#define __TLS_SHARED_H__
+
+#include "esp_http_client.h"
+#include "esp_transport.h"
+
+extern esp_err_t tls_shared_init(void);
+
+extern void tls_shared_http_config(esp_http_client_config_t *config);
+
+extern void tls_shared_ssl_transport(esp_transport_handle_t ssl);
+
+extern void tls_handshake_begin(void);
+
+extern void tls_handshake_end(void);
+
+#endif // __TLS_SHARED_H__
@@ -0,0 +1,127 @@
+#include "trace.h"
+
+#ifdef CONFIG_TRACE_ENABLE
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_timer.h"
+
+#define TRACE_RECORDS CONFIG_TRACE_RECORDS // per core, a power of two
+#define TRACE_TASKS 16                     // tasks that set a current message, the command, async and HTTP tasks and the workers
+
+_Static_assert((TRACE_RECORDS & (TRACE_RECORDS - 1)) == 0, "Trace records must be a power of two");
+_Static_assert(sizeof(trace_record_t) == 16, "Trace records should stay compact");
+
+static const char *const TRACE_stage_names[TRACE_STAGES] = {
+    [TRACE_WS_RECEIVE] = "ws_receive",
+    [TRACE_GATEWAY_TAKE] = "gateway_take",
+    [TRACE_COMMAND_QUEUED] = "command_queued",
+    [TRACE_COMMAND_TAKE] = "command_take",
+    [TRACE_COMMAND_RUN] = "command_run",
+    [TRACE_COMMAND_DONE] = "command_done",
+    [TRACE_HTTP_QUEUED] = "http_queued",
+    [TRACE_HTTP_START] = "http_start",
+    [TRACE_HTTP_DONE] = "http_done",
+    [TRACE_PAYLOAD_WAIT] = "payload_wait",
+    [TRACE_PAYLOAD_SENT] = "payload_sent",
+};
+
+// A writer claims a slot with an atomic add on the head of its core and fills it, nothing waits on anything
+// Only tasks on the same core share a ring, so the head is never contended between cores
+typedef struct trace_ring {
+    uint32_t head; // records written since the last dump, the slot is head % TRACE_RECORDS
+    trace_record_t records[TRACE_RECORDS];
+} trace_ring_t;
+
+typedef struct trace_task {
+    TaskHandle_t task; // NULL if the slot is free, a slot is claimed once and kept
+    uint64_t id;       // only the task itself reads or writes it
+} trace_task_t;
+
+static trace_ring_t TRACE_rings[portNUM_PROCESSORS];
+static trace_task_t TRACE_tasks[TRACE_TASKS];
+static bool TRACE_paused; // while a dump reads the rings
+
+extern uint32_t trace_now() {
+    return (uint32_t)esp_timer_get_time();
+}
+
+extern void trace_at(trace_stage_t stage, uint64_t id, uint32_t time_us) {
+    if (__atomic_load_n(&TRACE_paused, __ATOMIC_RELAXED)) {
+        return;
+    }
+    uint8_t core = xPortGetCoreID();
+    trace_ring_t *ring = &TRACE_rings[core];
+    trace_record_t *record = &ring->records[__atomic_fetch_add(&ring->head, 1, __ATOMIC_RELAXED) & (TRACE_RECORDS - 1)];
+    record->id = id;
+    record->time_us = time_us;
+    record->stage = stage;
+    record->core = core;
+}
+
+static trace_task_t *trace_task(bool claim) {
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    if (self == NULL) {
+        return NULL;
+    }
+    for (int i = 0; i < TRACE_TASKS; i++) {
+        if (__atomic_load_n(&TRACE_tasks[i].task, __ATOMIC_ACQUIRE) == self) {
+            return &TRACE_tasks[i];
+        }
+    }
+    for (int i = 0; claim && i < TRACE_TASKS; i++) {
+        TaskHandle_t empty = NULL;
+        if (__atomic_compare_exchange_n(&TRACE_tasks[i].task, &empty, self, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return &TRACE_tasks[i];
+        }
+    }
+    return NULL;
+}
+
+extern void trace_set_current(uint64_t id) {
+    trace_task_t *task = trace_task(id != 0);
+    if (task != NULL) {
+        task->id = id;
+    }
+}
+
+extern uint64_t trace_current() {
+    trace_task_t *task = trace_task(false);
+    return task != NULL ? task->id : 0;
+}
+
+// Records written while the dump reads are dropped, a record that was being filled as it started may come out torn
+extern int trace_dump() {
+    __atomic_store_n(&TRACE_paused, true, __ATOMIC_RELAXED);
+    vTaskDelay(1); // let writers that already passed the check finish their record
+    int total = 0;
+    printf("TRACE-BEGIN %d %d\n", portNUM_PROCESSORS, TRACE_RECORDS);
+    for (int stage = 0; stage < TRACE_STAGES; stage++) {
+        printf("TRACE-STAGE %d %s\n", stage, TRACE_stage_names[stage]);
+    }
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        trace_ring_t *ring = &TRACE_rings[core];
+        uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+        uint32_t count = head < TRACE_RECORDS ? head : TRACE_RECORDS;
+        for (uint32_t i = head - count; i != head; i++) { // oldest first
+            const trace_record_t *record = &ring->records[i & (TRACE_RECORDS - 1)];
+            printf("TRACE %u %u %" PRIu32 " %" PRIu64 "\n", record->core, record->stage, record->time_us, record->id);
+        }
+        if (head > TRACE_RECORDS) {
+            printf("TRACE-LOST %d %" PRIu32 "\n", core, head - TRACE_RECORDS);
+        }
+        total += count;
+        __atomic_store_n(&ring->head, 0, __ATOMIC_RELAXED);
+    }
+    printf("TRACE-END %d\n", total);
+    fflush(stdout);
+    __atomic_store_n(&TRACE_paused, false, __ATOMIC_RELAXED);
+    return total;
+}
+
+#endif // CONFIG_TRACE_ENABLE
@@ -0,0 +1,91 @@
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdint.h>
+#include <string.h>
+
+#include "sdkconfig.h"
+
+// Where a message is on its way from the websocket to the REST response, in the order it gets there
+// Only messages that reach a command are traced, chat the bot ignores is never parsed far enough to know its id
+// Gateway payloads the bot sends are traced too, their ids have TRACE_PAYLOAD set so they never look like a snowflake
+typedef enum trace_stage {
+    TRACE_WS_RECEIVE,     // websocket.c, the frame went on the gateway queue
+    TRACE_GATEWAY_TAKE,   // bot.c, BOT_payload_task took it off the queue
+    TRACE_COMMAND_QUEUED, // bot.c, parsed and put on BOT_command_queue
+    TRACE_COMMAND_TAKE,   // bot_cmd_manager.c, the command manager took it
+    TRACE_COMMAND_RUN,    // bot_cmd_manager.c, its handler or a continuation starts, inline or on a worker
+    TRACE_COMMAND_DONE,   // bot_cmd_manager.c, the handler or continuation returned
+    TRACE_HTTP_QUEUED,    // http_post.c, a request went on the HTTP queue
+    TRACE_HTTP_START,     // http_post.c, the HTTP task starts sending it, after waiting out any rate limit
+    TRACE_HTTP_DONE,      // http_post.c, the response was read
+    TRACE_PAYLOAD_WAIT,   // bot.c, a gateway payload starts its fixed delay
+    TRACE_PAYLOAD_SENT,   // bot.c, it was handed to the websocket
+    TRACE_STAGES,
+} trace_stage_t;
+
+#define TRACE_PAYLOAD (1ULL << 63)
+
+// 16 bytes, kept in a ring per core that is only ever claimed with an atomic add
+typedef struct trace_record {
+    uint64_t id;      // message snowflake, 0 if the stage could not tell which message it worked on
+    uint32_t time_us; // low bits of esp_timer_get_time, wraps after 71 minutes
+    uint8_t stage;
+    uint8_t core;
+    uint16_t reserved;
+} trace_record_t;
+
+#ifdef CONFIG_TRACE_ENABLE
+
+// Bytes behind each gateway queue item, the websocket leaves the receive time there for BOT_payload_task
+#define TRACE_STAMP_SIZE sizeof(uint32_t)
+
+extern uint32_t trace_now();
+extern void trace_at(trace_stage_t stage, uint64_t id, uint32_t time_us);
+
+// The message the calling task works on, requests it queues are traced under it
+extern void trace_set_current(uint64_t id);
+extern uint64_t trace_current();
+
+// Prints every record to the console as TRACE lines for host/trace.py, then starts over, returns how many there were
+extern int trace_dump();
+
+static inline void trace_point(trace_stage_t stage, uint64_t id) {
+    trace_at(stage, id, trace_now());
+}
+
+static inline void trace_stamp_write(char *stamp) {
+    uint32_t now = trace_now();
+    memcpy(stamp, &now, sizeof(now)); // behind the text, so it may not be aligned
+}
+
+static inline uint32_t trace_stamp_read(const char *stamp) {
+    uint32_t time_us;
+    memcpy(&time_us, stamp, sizeof(time_us));
+    return time_us;
+}
+
+#else
+
+#define TRACE_STAMP_SIZE 0
+
+static inline uint32_t trace_now() {
+    return 0;
+}
+static inline void trace_at(trace_stage_t stage, uint64_t id, uint32_t time_us) {}
+static inline void trace_set_current(uint64_t id) {}
+static inline uint64_t trace_current() {
+    return 0;
+}
+static inline int trace_dump() {
+    return 0;
+}
+static inline void trace_point(trace_stage_t stage, uint64_t id) {}
+static inline void trace_stamp_write(char *stamp) {}
+static inline uint32_t trace_stamp_read(const char *stamp) {
+    return 0;
+}
+
+#endif // CONFIG_TRACE_ENABLE
+
+#endif // __TRACE_H__
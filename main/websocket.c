@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <string.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
@@ -16,10 +17,17 @@
 #ifdef CONFIG_BLINK_ENABLE
 #include "blink.c"
 #endif
+#ifdef CONFIG_IDF_TARGET_LINUX
+#include "esp_websocket_client.h" // replays recorded frames, see host/
+#else
 #include "esp_websocket_client_mod.c"
+#endif
+#include "mem_place.h"
+#include "trace.h"
 
 #define NO_DATA_TIMEOUT_SEC CONFIG_WEBSOCKET_TIMEOUT_SEC // TODO: implement websocket timeout
 #define WEBSOCKET_BUFFER_SIZE CONFIG_WEBSOCKET_BUFFER_SIZE
+#define WEBSOCKET_ITEM_SIZE (WEBSOCKET_BUFFER_SIZE + 1 + TRACE_STAMP_SIZE) // text, its terminator and when it arrived
 #define WEBSOCKET_URI CONFIG_WEBSOCKET_URI
 #define MAX_MESSAGE_QUEUE CONFIG_WEBSOCKET_QUEUE_SIZE
 
@@ -27,6 +35,7 @@ static const char WS_TAG[] = "WebSocket";
 
 static esp_websocket_client_handle_t client;
 static QueueHandle_t message_queue;
+static char *websocket_staging; // a frame is built into a whole queue item here, only the client task writes it
 
 static void websocket_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data) {
     esp_websocket_event_data_t *data = (esp_websocket_event_data_t *)event_data;
@@ -48,13 +57,19 @@ static void websocket_event_handler(void *handler_args, esp_event_base_t base, i
         blink();
 #endif
         ESP_LOGI(WS_TAG, "WEBSOCKET_EVENT_DATA");
-        if (data->data_len > 0) {
-            char *msg = calloc(1, 1 + (data->data_len));
-            snprintf(msg, 1 + (data->data_len), data->data_ptr);
-            if (xQueueSendToBack(message_queue, msg, 0) == errQUEUE_FULL) {
+        if (data->payload_len > WEBSOCKET_BUFFER_SIZE || data->data_len > WEBSOCKET_BUFFER_SIZE) {
+            // Arrives in pieces that are no use on their own, a cut off payload would not parse either
+            if (data->payload_offset == 0) {
+                ESP_LOGW(WS_TAG, "Dropping a %d byte payload, it does not fit in %d bytes", data->payload_len, WEBSOCKET_BUFFER_SIZE);
+            }
+        } else if (data->data_len > 0) {
+            // The queue copies a whole item, so the frame is staged in one that is that big
+            memcpy(websocket_staging, data->data_ptr, data->data_len);
+            websocket_staging[data->data_len] = '\0';
+            trace_stamp_write(websocket_staging + WEBSOCKET_BUFFER_SIZE + 1); // TRACE_WS_RECEIVE, recorded once the message id is known
+            if (xQueueSendToBack(message_queue, websocket_staging, 0) == errQUEUE_FULL) {
                 ESP_LOGE(WS_TAG, "Message queue is full, unable to receive last message");
             }
-            free(msg);
         } else {
             ESP_LOGW(WS_TAG, "Data received was of length 0");
         }
@@ -73,10 +88,18 @@ extern void websocket_send_text(char *data) {
 }
 
 extern esp_err_t websocket_app_start(void) {
+    if (websocket_staging == NULL) {
+        websocket_staging = mem_place_alloc("gateway staging", WEBSOCKET_ITEM_SIZE, MEM_BULK);
+        if (websocket_staging == NULL) {
+            ESP_LOGE(WS_TAG, "Unable to allocate the frame staging buffer");
+            return ESP_ERR_NO_MEM;
+        }
+    }
     esp_websocket_client_config_t websocket_cfg = {
         .disable_auto_reconnect = true, // Must implement this with discord API
         .uri = WEBSOCKET_URI,
         .buffer_size = WEBSOCKET_BUFFER_SIZE,
+        .shared_tls = true,
     };
 
     ESP_LOGI(WS_TAG, "Connecting to %s...", websocket_cfg.uri);
@@ -93,7 +116,7 @@ extern void websocket_app_stop(void) {
 }
 
 extern QueueHandle_t websocket_init(void) {
-    message_queue = xQueueCreate(MAX_MESSAGE_QUEUE, WEBSOCKET_BUFFER_SIZE + 1);
+    message_queue = mem_place_queue("gateway queue", MAX_MESSAGE_QUEUE, WEBSOCKET_ITEM_SIZE, MEM_BULK);
     if (message_queue == NULL) {
         ESP_LOGE(WS_TAG, "Unable to create message queue");
     }